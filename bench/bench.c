@@ -0,0 +1,395 @@
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lexer.h"
+
+// throughput benchmark over generated corpora. every corpus is built from
+// a fixed seed so runs are comparable across builds, and is lexed in its
+// own child process so the peak RSS reported is that corpus' alone
+
+#define BENCH_DEFAULT_MB 16
+#define BENCH_DEFAULT_RUNS 10
+
+typedef struct {
+    char *data;
+    size_t length, capacity;
+    uint64_t state;
+} Corpus;
+
+static void corpus_put(Corpus *corpus, const char *text, size_t length) {
+    if (corpus->length + length > corpus->capacity) {
+        size_t capacity = corpus->capacity ? corpus->capacity * 2 : 1024 * 1024;
+        while (capacity < corpus->length + length) capacity *= 2;
+
+        char *grown = realloc(corpus->data, capacity);
+        if (!grown) {
+            perror("bench");
+            exit(EXIT_FAILURE);
+        }
+        corpus->data = grown;
+        corpus->capacity = capacity;
+    }
+
+    memcpy(corpus->data + corpus->length, text, length);
+    corpus->length += length;
+}
+
+static void corpus_puts(Corpus *corpus, const char *text) { corpus_put(corpus, text, strlen(text)); }
+
+// xorshift64*, fixed seed per corpus
+static uint32_t corpus_random(Corpus *corpus, uint32_t bound) {
+    corpus->state ^= corpus->state >> 12;
+    corpus->state ^= corpus->state << 25;
+    corpus->state ^= corpus->state >> 27;
+    return (uint32_t)((corpus->state * 0x2545F4914F6CDD1DULL) >> 32) % bound;
+}
+
+static const char *pick(Corpus *corpus, const char **words, size_t count) {
+    return words[corpus_random(corpus, count)];
+}
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+static const char *identifiers[] = {
+    "i", "count", "buffer_length", "lexer", "token_index", "x1", "next_state",
+    "_private", "HashMapEntry", "result", "source_position", "a_rather_long_identifier_name",
+};
+static const char *keywords_used[] = { "int", "return", "while", "static", "const", "struct", "unsigned", "if" };
+static const char *punctuation[] = { " = ", ";", ", ", "(", ")", " + ", " * ", "{", "}", "[", "]", " < ", "->" };
+static const char *numbers[] = {
+    "0", "1", "42", "65536", "0x1F", "0xdeadBEEF", "0b1011", "0755", "42u", "7ul", "100ll", "3.25", "1.5f", "0.000125",
+};
+static const char *strings[] = {
+    "\"hello, world\"", "\"%s: %zu bytes\\n\"", "\"\"", "\"a somewhat longer string literal with spaces in it\"",
+    "'a'", "'x'", "'0'",
+};
+static const char *comments[] = {
+    "// short comment",
+    "// TODO: handle the case where the buffer is full and the writer is blocked",
+    "//////////////////////////////////////////////////////////////////////////////",
+    "// see the note above, the table must stay sorted",
+};
+
+static const char *block_comments[] = {
+    "/*\n"
+    " * Copyright (c) the authors. All rights reserved.\n"
+    " *\n"
+    " * Permission is hereby granted, free of charge, to any person obtaining a copy\n"
+    " * of this software and associated documentation files, to deal in the software\n"
+    " * without restriction, subject to the conditions in the LICENSE file.\n"
+    " */\n",
+    "/**\n"
+    " * Returns the next token of the stream, or 0 once the input is exhausted.\n"
+    " *\n"
+    " * @param lexer  the lexer to advance\n"
+    " * @param token  filled with the token on success\n"
+    " */\n",
+    "    /* the buffer is full, flush it before the next write */\n",
+    "/***************************************************************************/\n",
+};
+
+typedef void (*Line_fn)(Corpus *corpus);
+
+static void identifier_line(Corpus *corpus) {
+    corpus_puts(corpus, "    ");
+    for (int i = 0; i < 8; i++) {
+        corpus_puts(corpus, corpus_random(corpus, 4) == 0 ? pick(corpus, keywords_used, COUNT(keywords_used))
+                                                          : pick(corpus, identifiers, COUNT(identifiers)));
+        corpus_puts(corpus, corpus_random(corpus, 2) ? " " : pick(corpus, punctuation, COUNT(punctuation)));
+    }
+    corpus_puts(corpus, ";\n");
+}
+
+static void number_line(Corpus *corpus) {
+    corpus_puts(corpus, "    { ");
+    for (int i = 0; i < 10; i++) {
+        corpus_puts(corpus, pick(corpus, numbers, COUNT(numbers)));
+        corpus_puts(corpus, ", ");
+    }
+    corpus_puts(corpus, "},\n");
+}
+
+static void string_line(Corpus *corpus) {
+    corpus_puts(corpus, "    print(");
+    for (int i = 0; i < 4; i++) {
+        corpus_puts(corpus, pick(corpus, strings, COUNT(strings)));
+        corpus_puts(corpus, ", ");
+    }
+    corpus_puts(corpus, "0);\n");
+}
+
+static void comment_line(Corpus *corpus) {
+    if (corpus_random(corpus, 4) == 0) {
+        identifier_line(corpus);
+        return;
+    }
+    corpus_puts(corpus, corpus_random(corpus, 2) ? "" : "        ");
+    corpus_puts(corpus, pick(corpus, comments, COUNT(comments)));
+    corpus_puts(corpus, "\n");
+}
+
+// license headers and doc comments, each followed by the code it documents
+static void block_comment_line(Corpus *corpus) {
+    corpus_puts(corpus, pick(corpus, block_comments, COUNT(block_comments)));
+    identifier_line(corpus);
+}
+
+// a whole minified block on one line
+static void long_line(Corpus *corpus) {
+    for (int i = 0; i < 400; i++) {
+        switch (corpus_random(corpus, 4)) {
+            case 0: corpus_puts(corpus, pick(corpus, numbers, COUNT(numbers))); break;
+            case 1: corpus_puts(corpus, pick(corpus, strings, COUNT(strings))); break;
+            default: corpus_puts(corpus, pick(corpus, identifiers, COUNT(identifiers))); break;
+        }
+        corpus_puts(corpus, pick(corpus, punctuation, COUNT(punctuation)));
+    }
+    corpus_puts(corpus, "\n");
+}
+
+static void mixed_line(Corpus *corpus) {
+    static const Line_fn lines[] = { identifier_line, identifier_line, identifier_line, number_line, string_line, comment_line };
+    lines[corpus_random(corpus, COUNT(lines))](corpus);
+}
+
+typedef struct {
+    const char *name;
+    Line_fn line;
+} Corpus_kind;
+
+static const Corpus_kind corpus_kinds[] = {
+    { "identifiers", identifier_line },
+    { "numbers", number_line },
+    { "strings", string_line },
+    { "comments", comment_line },
+    { "block-comments", block_comment_line },
+    { "long-lines", long_line },
+    { "mixed", mixed_line },
+};
+
+static void corpus_generate(Corpus *corpus, const Corpus_kind *kind, size_t bytes) {
+    memset(corpus, 0, sizeof *corpus);
+    corpus->state = 0x9E3779B97F4A7C15ULL;
+    for (const char *c = kind->name; *c; c++) {
+        corpus->state = (corpus->state ^ (unsigned char)*c) * 0x100000001B3ULL;
+    }
+
+    while (corpus->length < bytes) {
+        kind->line(corpus);
+    }
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// lexes the corpus runs times after one warm up run and prints one row.
+// with symbols the warm up run fills the table, the timed runs then only
+// look identifiers up like a second pass over the same project would
+static void bench_corpus(const Corpus_kind *kind, size_t bytes, int runs, int symbols) {
+    Corpus corpus;
+    corpus_generate(&corpus, kind, bytes);
+
+    Lexer lexer;
+    lexer_initialize(&lexer);
+
+    Intern_table table;
+    if (symbols) {
+        if (intern_table_initialize(&table) < 0) {
+            perror("intern_table_initialize");
+            exit(EXIT_FAILURE);
+        }
+        lexer_set_symbols(&lexer, &table);
+    }
+
+    double *times = malloc(sizeof(double) * runs);
+    size_t tokens = 0;
+
+    for (int run = -1; run < runs; run++) {
+        lexer_reset(&lexer);
+        lexer_set_source(&lexer, corpus.data, corpus.length);
+
+        double start = now_seconds();
+        tokens = lexer_scan_all(&lexer);
+        double elapsed = now_seconds() - start;
+
+        if (run >= 0) times[run] = elapsed;
+    }
+
+    qsort(times, runs, sizeof(double), compare_double);
+    double median = runs % 2 ? times[runs / 2] : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+    double mean = 0, deviation = 0;
+    for (int i = 0; i < runs; i++) mean += times[i];
+    mean /= runs;
+    for (int i = 0; i < runs; i++) deviation += (times[i] - mean) * (times[i] - mean);
+    deviation = runs > 1 ? sqrt(deviation / (runs - 1)) : 0;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double mb = corpus.length / (1024.0 * 1024.0);
+    printf("%-14s %8.2f %10zu %9.1f %9.1f %6.1f%% %9.2f %8.2f %9ld\n",
+           kind->name, mb, tokens, mb / median, mb / times[0], 100 * deviation / mean,
+           tokens / median / 1e6, median * 1e9 / tokens, usage.ru_maxrss);
+    fflush(stdout);
+
+    free(times);
+    lexer_cleanup(&lexer);
+    if (symbols) {
+        intern_table_free(&table);
+    }
+    free(corpus.data);
+}
+
+static int write_corpus(const Corpus_kind *kind, size_t bytes, const char *directory) {
+    Corpus corpus;
+    corpus_generate(&corpus, kind, bytes);
+
+    char path[4096];
+    snprintf(path, sizeof path, "%s/%s.c", directory, kind->name);
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        free(corpus.data);
+        return -1;
+    }
+
+    fwrite(corpus.data, 1, corpus.length, file);
+    fclose(file);
+    free(corpus.data);
+    fprintf(stderr, "wrote %s\n", path);
+    return 0;
+}
+
+static void usage(FILE *out, const char *program) {
+    fprintf(out,
+            "usage: %s [options] [corpus...]\n"
+            "\n"
+            "Lexes generated corpora and reports median throughput, the best run,\n"
+            "the run to run deviation, ns per token and the peak RSS of each.\n"
+            "Corpora: identifiers numbers strings comments block-comments long-lines mixed (default all)\n"
+            "\n"
+            "  -s, --size MB         corpus size (default %d)\n"
+            "  -r, --runs N          timed runs per corpus after one warm up (default %d)\n"
+            "  -y, --symbols         intern identifiers while lexing\n"
+            "  -w, --write DIR       write the corpora to DIR instead of lexing them\n"
+            "  -h, --help            show this help\n",
+            program, BENCH_DEFAULT_MB, BENCH_DEFAULT_RUNS);
+}
+
+int main(int argc, char **argv) {
+    static struct option long_options[] = {
+        {"size", required_argument, NULL, 's'},
+        {"runs", required_argument, NULL, 'r'},
+        {"symbols", no_argument, NULL, 'y'},
+        {"write", required_argument, NULL, 'w'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    size_t bytes = (size_t)BENCH_DEFAULT_MB * 1024 * 1024;
+    int runs = BENCH_DEFAULT_RUNS;
+    const char *directory = NULL;
+    int symbols = 0;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:r:yw:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 's':
+                bytes = (size_t)(atof(optarg) * 1024 * 1024);
+                if (bytes == 0) {
+                    fprintf(stderr, "invalid size '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'r':
+                runs = atoi(optarg);
+                if (runs < 1) {
+                    fprintf(stderr, "invalid run count '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'y':
+                symbols = 1;
+                break;
+
+            case 'w':
+                directory = optarg;
+                break;
+
+            case 'h':
+                usage(stdout, argv[0]);
+                return 0;
+
+            default:
+                usage(stderr, argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    const Corpus_kind *selected[COUNT(corpus_kinds)];
+    size_t selected_count = 0;
+
+    if (optind == argc) {
+        for (size_t i = 0; i < COUNT(corpus_kinds); i++) selected[selected_count++] = &corpus_kinds[i];
+    }
+    for (int i = optind; i < argc && selected_count < COUNT(corpus_kinds); i++) {
+        size_t k = 0;
+        while (k < COUNT(corpus_kinds) && strcmp(argv[i], corpus_kinds[k].name) != 0) k++;
+
+        if (k == COUNT(corpus_kinds)) {
+            fprintf(stderr, "unknown corpus '%s'\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+        selected[selected_count++] = &corpus_kinds[k];
+    }
+
+    if (directory) {
+        for (size_t i = 0; i < selected_count; i++) {
+            if (write_corpus(selected[i], bytes, directory) < 0) exit(EXIT_FAILURE);
+        }
+        return 0;
+    }
+
+    printf("%-14s %8s %10s %9s %9s %7s %9s %8s %9s\n",
+           "corpus", "MB", "tokens", "MB/s", "best", "stddev", "Mtok/s", "ns/tok", "RSS KB");
+    fflush(stdout);
+
+    for (size_t i = 0; i < selected_count; i++) {
+        pid_t child = fork();
+        if (child < 0) {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (child == 0) {
+            bench_corpus(selected[i], bytes, runs, symbols);
+            _exit(0);
+        }
+
+        int status;
+        if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "benchmark of '%s' failed\n", selected[i]->name);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return 0;
+}
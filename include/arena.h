@@ -0,0 +1,26 @@
+#ifndef _ARENA_
+#define _ARENA_
+#include <stddef.h>
+#include <stdlib.h>
+
+#define ARENA_CHUNK_SIZE (256 * 1024)
+
+typedef struct Arena_chunk {
+    struct Arena_chunk *next;
+    size_t used, capacity;
+    _Alignas(max_align_t) char data[];
+} Arena_chunk;
+
+// bump allocator made of a list of chunks. memory is only handed back
+// all at once, either kept around by arena_reset or released by arena_free
+typedef struct {
+    Arena_chunk *first;
+    Arena_chunk *current;
+} Arena;
+
+void arena_initialize(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+
+#endif
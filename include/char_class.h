@@ -0,0 +1,23 @@
+#ifndef _CHAR_CLASS_
+#define _CHAR_CLASS_
+#include <stdint.h>
+
+// one lookup per byte instead of the locale aware ctype calls. a byte can
+// belong to several classes, the scanner loops while (class & mask)
+#define CHAR_SPACE   0x001 // blanks other than newline
+#define CHAR_ALPHA   0x002
+#define CHAR_DIGIT   0x004
+#define CHAR_IDENT   0x008 // identifier body: letters, digits and _
+#define CHAR_NUMBER  0x010 // number literal body: letters, digits and .
+#define CHAR_HEX     0x020
+#define CHAR_STRING  0x040 // allowed inside "..."
+#define CHAR_CHAR    0x080 // allowed inside '...'
+#define CHAR_COMMENT 0x100 // allowed inside a // comment
+
+extern const uint16_t char_class[256];
+
+static inline int char_is(char ch, uint16_t mask) {
+    return char_class[(unsigned char)ch] & mask;
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef _DIAGNOSTIC_
+#define _DIAGNOSTIC_
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DIAGNOSTIC_MESSAGE_SIZE 96
+
+typedef enum {
+    DIAGNOSTIC_NUMBER_SUFFIX,
+    DIAGNOSTIC_HEX_DIGIT,
+    DIAGNOSTIC_BINARY_DIGIT,
+    DIAGNOSTIC_OCTAL_DIGIT,
+    DIAGNOSTIC_NUMBER_CHARACTER,
+    DIAGNOSTIC_UNTERMINATED_STRING,
+    DIAGNOSTIC_UNTERMINATED_CHAR,
+    DIAGNOSTIC_MULTI_CHAR,
+    DIAGNOSTIC_UNTERMINATED_COMMENT,
+} Diagnostic_code;
+
+// an error found while lexing. offset is where the bad literal starts,
+// the TOKEN_INVALID that replaced it starts there too, or where an
+// unterminated comment opens. the message is self contained so
+// diagnostics can be copied between lexers
+typedef struct {
+    uint32_t offset;
+    uint32_t line, col;
+    Diagnostic_code code;
+    char message[DIAGNOSTIC_MESSAGE_SIZE];
+} Diagnostic;
+
+// in source order
+typedef struct {
+    Diagnostic *items;
+    size_t count, capacity;
+} Diagnostic_list;
+
+void diagnostic_list_initialize(Diagnostic_list *list);
+Diagnostic *diagnostic_list_push(Diagnostic_list *list);
+int diagnostic_list_splice(Diagnostic_list *list, size_t index, size_t removed,
+                           const Diagnostic *items, size_t count);
+void diagnostic_list_clear(Diagnostic_list *list);
+void diagnostic_list_free(Diagnostic_list *list);
+const char *get_diagnostic_name(Diagnostic_code code);
+void diagnostic_print(FILE *out, const char *path, const Diagnostic *diagnostic);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef _DRIVER_
+#define _DRIVER_
+#include <stdlib.h>
+
+#include "header_cache.h"
+#include "printer.h"
+#include "token_cache.h"
+
+typedef struct {
+    char *path;
+    size_t bytes;
+    size_t tokens;
+    // errno from opening the file, 0 when it was lexed
+    int error;
+    // the tokens came from the token cache
+    int cached;
+    // diagnostics reported for the file
+    size_t errors;
+    // its #include directives that were found in the search paths
+    size_t includes;
+    // the file is a header, lexed into its shared entry of the header cache
+    Header *header;
+} Driver_file;
+
+typedef struct {
+    Driver_file *files;
+    size_t count, capacity;
+} Driver_file_list;
+
+typedef struct {
+    int jobs;
+    // print every token stream instead of a per file count
+    int print;
+    Print_format format;
+    int color;
+    // reuse token streams of unchanged files, NULL to always lex
+    Token_cache *cache;
+    // one symbol space for the identifiers of every file, NULL to not intern
+    Intern_table *symbols;
+    // follow #include directives and lex every header reached once, NULL
+    // to only lex the inputs
+    Header_cache *headers;
+} Driver_options;
+
+void driver_file_list_initialize(Driver_file_list *list);
+int driver_add_path(Driver_file_list *list, const char *path);
+int driver_add_list_file(Driver_file_list *list, const char *list_path);
+void driver_file_list_free(Driver_file_list *list);
+
+int driver_run(Driver_file_list *list, Driver_options *options);
+
+#endif
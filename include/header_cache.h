@@ -0,0 +1,63 @@
+#ifndef _HEADER_CACHE_
+#define _HEADER_CACHE_
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "input.h"
+#include "lexer.h"
+
+// include following. #include "..." and <...> are resolved against the
+// search paths and every file reached that way is lexed once, into a
+// lexer of its own that is never changed afterwards. every translation
+// unit that includes the header shares those tokens, so a project costs
+// one lex per unique file instead of one per include
+
+// one #include directive found among a lexer's tokens
+typedef struct {
+    // the name between the quotes or brackets, points into the source
+    const char *name;
+    size_t length;
+    // <...>, only the search paths are tried
+    int angled;
+    // offset of the '#'
+    uint32_t offset;
+} Include;
+
+typedef struct {
+    // the resolved path, the key of the cache
+    char *path;
+    // given as an input and lexed as one, not only reached by #include
+    int input;
+    // filled in once by whoever claimed the header, read only after that
+    Source_file source;
+    Lexer lexer;
+    // errno from opening the file, 0 when it was lexed
+    int error;
+    // the tokens came from the token cache
+    int cached;
+} Header;
+
+typedef struct {
+    // searched in order, for "..." after the directory of the includer
+    char **dirs;
+    size_t dir_count, dir_capacity;
+
+    pthread_mutex_t lock;
+    // open addressing on a hash of the path
+    Header **slots;
+    size_t mask;
+    // in the order they were claimed
+    Header **headers;
+    size_t count, capacity;
+} Header_cache;
+
+int header_cache_initialize(Header_cache *cache);
+int header_cache_add_dir(Header_cache *cache, const char *dir);
+int header_cache_resolve(Header_cache *cache, const char *includer, const Include *include, char *path,
+                         size_t size);
+Header *header_cache_claim(Header_cache *cache, const char *path, int *created);
+void header_cache_free(Header_cache *cache);
+
+int include_next(Lexer *lexer, size_t *index, Include *include);
+
+#endif
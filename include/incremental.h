@@ -0,0 +1,32 @@
+#ifndef _INCREMENTAL_
+#define _INCREMENTAL_
+#include <stdlib.h>
+
+#include "lexer.h"
+
+// a lexed buffer that is kept up to date under edits, for editors that
+// re-lex on every keystroke. owns a copy of the text, lexer.tokens is the
+// token stream of the current text
+typedef struct {
+    Lexer lexer;
+    char *text;
+    size_t length, capacity;
+    // re-lexed tokens of the last edit, kept to reuse its arrays
+    Lexer scratch;
+} Incremental_lexer;
+
+// tokens [first, first + removed) of the old stream were replaced by
+// tokens [first, first + inserted) of the new one
+typedef struct {
+    size_t first;
+    size_t removed;
+    size_t inserted;
+} Token_edit;
+
+int incremental_initialize(Incremental_lexer *inc, const char *text, size_t length);
+void incremental_set_symbols(Incremental_lexer *inc, Intern_table *symbols);
+int incremental_edit(Incremental_lexer *inc, size_t offset, size_t removed,
+                     const char *inserted, size_t inserted_length, Token_edit *changed);
+void incremental_cleanup(Incremental_lexer *inc);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef _INPUT_
+#define _INPUT_
+#include <stdlib.h>
+
+// whole input file, either mmapped (regular files) or read into
+// a heap buffer (pipes, stdin). data is not NUL terminated
+typedef struct {
+    const char *data;
+    size_t length;
+    int mapped;
+} Source_file;
+
+// input read block by block for a streaming lexer, only the bytes not yet
+// consumed plus one block are held. plugs into lexer_set_refill
+typedef struct {
+    int fd;
+    char *data;
+    size_t length;
+    size_t capacity;
+    size_t block_size;
+} Source_stream;
+
+#define STREAM_BLOCK_MIN (4 * 1024)
+#define STREAM_BLOCK_DEFAULT (256 * 1024)
+
+int source_file_open(const char *path, Source_file *file);
+void source_file_close(Source_file *file);
+int source_stream_open(const char *path, size_t block_size, Source_stream *stream);
+size_t source_stream_refill(void *context, size_t consumed, const char **window);
+void source_stream_close(Source_stream *stream);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef _INTERN_
+#define _INTERN_
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+// identifier interning. every distinct spelling is stored once and gets a
+// dense 32 bit symbol id, ids are handed out from 0 in the order spellings
+// are first seen, so comparing identifiers is comparing ids. one table can
+// be shared by any number of lexers on any number of threads: the table is
+// split into shards by hash, lookups never lock and only a new spelling
+// takes the lock of its shard
+
+#define INTERN_SHARD_BITS 6
+#define INTERN_SHARDS (1 << INTERN_SHARD_BITS)
+
+// symbols are kept in blocks that never move, so a symbol can be read
+// while other threads add more
+#define INTERN_BLOCK_BITS 12
+#define INTERN_BLOCK_SIZE (1 << INTERN_BLOCK_BITS)
+#define INTERN_MAX_BLOCKS (1 << 19)
+
+#define INTERN_NONE UINT32_MAX
+
+typedef struct {
+    // NUL terminated copy of the spelling
+    const char *text;
+    uint32_t length;
+    // the full hash, kept so growing a shard never rehashes text
+    uint64_t hash;
+} Intern_symbol;
+
+// open addressing with linear probing. a slot is the high half of the
+// hash and id + 1, 0 when empty, so most mismatches are rejected without
+// touching the symbol
+typedef struct Intern_slots {
+    size_t mask;
+    // replaced arrays stay alive until intern_table_free, a lookup that
+    // started on one may still be reading it
+    struct Intern_slots *retired;
+    uint64_t slots[];
+} Intern_slots;
+
+typedef struct {
+    pthread_mutex_t lock;
+    Intern_slots *slots;
+    size_t count;
+    // the text of the shard's symbols
+    Arena arena;
+} Intern_shard;
+
+typedef struct {
+    Intern_shard shards[INTERN_SHARDS];
+    // INTERN_MAX_BLOCKS pointers, allocated on demand
+    Intern_symbol **blocks;
+    pthread_mutex_t block_lock;
+    uint32_t count;
+} Intern_table;
+
+int intern_table_initialize(Intern_table *table);
+uint32_t intern(Intern_table *table, const char *text, size_t length);
+uint32_t intern_find(Intern_table *table, const char *text, size_t length);
+const char *intern_text(Intern_table *table, uint32_t id, size_t *length);
+size_t intern_count(Intern_table *table);
+void intern_table_free(Intern_table *table);
+
+#endif
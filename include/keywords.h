@@ -0,0 +1,10 @@
+#ifndef _KEYWORDS_
+#define _KEYWORDS_
+#include <stddef.h>
+
+extern const char *keywords[];
+
+void keyword_table_initialize(void);
+int is_keyword(const char *word, size_t length);
+
+#endif
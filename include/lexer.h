@@ -1,9 +1,14 @@
 #ifndef _LEXER_
 #define _LEXER_
-#define MAX_ID_LEN 256
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 
-#include "hash_map.h"
+#include "diagnostic.h"
+#include "intern.h"
+#include "line_index.h"
+#include "number.h"
+#include "token_buffer.h"
 
 typedef enum {
     TOKEN_IDENTIFIER,
@@ -38,31 +43,122 @@ typedef enum {
     TOKEN_NUMBER_LITERAL,
     TOKEN_STRING_LITERAL,
     TOKEN_CHAR_LITERAL,
+    TOKEN_TILDE,
+    TOKEN_ELLIPSIS,
+    TOKEN_ARROW,
+    TOKEN_INCREMENT,
+    TOKEN_DECREMENT,
+    TOKEN_PLUS_EQUAL,
+    TOKEN_MINUS_EQUAL,
+    TOKEN_ASTERISK_EQUAL,
+    TOKEN_FORWARDSLASH_EQUAL,
+    TOKEN_MODULO_EQUAL,
+    TOKEN_EQUAL_EQUAL,
+    TOKEN_NOT_EQUAL,
+    TOKEN_LOGICAL_AND,
+    TOKEN_AMPERSAND_EQUAL,
+    TOKEN_LOGICAL_OR,
+    TOKEN_PIPE_EQUAL,
+    TOKEN_XOR_EQUAL,
+    TOKEN_LESS_EQUAL,
+    TOKEN_LEFT_SHIFT,
+    TOKEN_LEFT_SHIFT_EQUAL,
+    TOKEN_GREATER_EQUAL,
+    TOKEN_RIGHT_SHIFT,
+    TOKEN_RIGHT_SHIFT_EQUAL,
+    TOKEN_DOUBLE_HASHTAG,
     TOKEN_EOF
 } TokenType;
 
-typedef struct Token {
+// bump whenever the tokens produced for some input change, token streams
+// cached by another version are then never used
+#define LEXER_VERSION 3
+
+// a lexer_scan call may read this many bytes past the last token it
+// emits, "..x" is only known to be two dots at the x
+#define LEXER_LOOKAHEAD 2
+
+// a token does not own its text, it is the span [offset, offset + length)
+// of the lexer source, see token_text. its line and col are not stored,
+// lexer_position finds them from the offset. offsets are 32 bit so a
+// single input is limited to 4GB. tokens are stored column wise in the
+// lexer's Token_buffer, this struct is just a copy of one row. payload is
+// the symbol id of an identifier when the lexer interns (see
+// lexer_set_symbols). for a number literal payload holds its NUMBER_*
+// flags and value its decoded value (see number.h), both are 0 otherwise
+typedef struct {
+    uint32_t offset, length;
     TokenType type;
-    char value[MAX_ID_LEN];
-    size_t line, col;
-    struct Token *next;
+    uint32_t payload;
+    uint64_t value;
 } Token;
 
+// asked by lexer_next for more input: drop the first consumed bytes of
+// the window, append what comes next after the rest and return the new
+// window through window and its length. returning no more than the kept
+// bytes means the input has ended
+typedef size_t (*Lexer_refill_fn)(void *context, size_t consumed, const char **window);
+
 typedef struct {
-    Token *head;
-    char *source;
-    size_t line, col;
+    Token_buffer tokens;
+    // whole input or the current streaming window, not NUL terminated.
+    // scanning stops at length
+    const char *source;
+    size_t length;
     size_t position;
+    // streaming input, see lexer_set_refill. source[0] is the byte at
+    // absolute offset base, token offsets are absolute
+    size_t base;
+    Lexer_refill_fn refill;
+    void *refill_context;
+    int input_done;
+    // window index of a newline at or after position, if line_end < length
+    size_t line_end;
+    // a streamed block comment ran past the window and goes on in the
+    // next one, where its "/*" was
+    int in_comment;
+    size_t comment_offset;
+    Source_position comment_position;
+    // line starts of the source, filled as far as positions are asked
+    // for. a stream keeps the lines of its window only
+    Line_index lines;
+    // identifiers are interned here when set, it is not owned and may be
+    // shared with other lexers
+    Intern_table *symbols;
+    // lexer_next hands out tokens[next_token..count) before scanning again
+    size_t next_token;
+    // bad literals become TOKEN_INVALID and are reported here, lexing
+    // goes on after them. cleared by lexer_reset
+    Diagnostic_list diagnostics;
+    // diagnostics[0..located) have their line and col, see
+    // lexer_locate_diagnostics
+    size_t located;
 } Lexer;
 
-extern char *keywords[];
-extern Hash_map keyword_map;
+typedef struct {
+    Lexer *lexer;
+    size_t index;
+} Token_iter;
+
 
-Token *lexer_scan(Lexer *lexer);
+int lexer_scan(Lexer *lexer);
+size_t lexer_scan_all(Lexer *lexer);
 void lexer_initialize(Lexer *lexer);
+void lexer_set_source(Lexer *lexer, const char *source, size_t length);
+void lexer_set_refill(Lexer *lexer, Lexer_refill_fn refill, void *context);
+void lexer_set_symbols(Lexer *lexer, Intern_table *symbols);
+void lexer_intern_tokens(Lexer *lexer, size_t from, size_t to);
+void lexer_decode_numbers(Lexer *lexer, size_t from, size_t to);
+Source_position lexer_position(Lexer *lexer, uint32_t offset);
+void lexer_locate_diagnostics(Lexer *lexer);
+int lexer_next(Lexer *lexer, Token *token);
 const char *get_token_name(TokenType type);
-void print_tokens(Lexer *lexer);
+void lexer_reset(Lexer *lexer);
 void lexer_cleanup(Lexer *lexer);
 char lexer_peek(Lexer *lexer);
+const char *token_text(Lexer *lexer, const Token *token);
+Token token_at(Lexer *lexer, size_t index);
+void token_iter_initialize(Token_iter *iter, Lexer *lexer);
+int token_iter_next(Token_iter *iter, Token *token);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef _LINE_INDEX_
+#define _LINE_INDEX_
+#include <stddef.h>
+#include <stdint.h>
+
+// the offsets lines start at, so tokens only need to store a byte offset.
+// the index is filled by a separate vectorized pass over the newlines,
+// only as far as positions are asked for, and answers offset -> (line,
+// col) by binary search. cols count bytes from 1
+typedef struct {
+    // starts[i] is the absolute offset line first_line + i starts at
+    uint32_t *starts;
+    size_t count, capacity;
+    uint32_t first_line;
+    // newlines before this absolute offset are in starts
+    size_t scanned;
+    // index of the last line found, lookups in source order hit it or
+    // the next one
+    size_t hint;
+} Line_index;
+
+typedef struct {
+    uint32_t line, col;
+} Source_position;
+
+void line_index_initialize(Line_index *index);
+void line_index_clear(Line_index *index);
+void line_index_scan(Line_index *index, const char *data, size_t length);
+Source_position line_index_find(Line_index *index, uint32_t offset);
+void line_index_drop(Line_index *index, uint32_t offset);
+void line_index_edit(Line_index *index, uint32_t offset, uint32_t removed, const char *inserted,
+                     uint32_t inserted_length);
+void line_index_free(Line_index *index);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef _NUMBER_
+#define _NUMBER_
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "diagnostic.h"
+
+// number literals are validated and decoded in the same forward pass
+// that finds where they end. a literal is a run of letters, digits and
+// '.', it is good when it is
+//   0x / 0X followed by hex digits, 0b / 0B followed by binary digits,
+//   0 followed by octal digits (all without a suffix), or
+//   decimal digits and dots with an optional f, u, l, ul, ll or ull
+// a decimal with a '.' or an f suffix is a float
+
+// what the payload of a TOKEN_NUMBER_LITERAL says about its value
+#define NUMBER_FLOAT     0x01 // value holds the bits of a double, otherwise a uint64_t
+#define NUMBER_OVERFLOW  0x02 // the integer does not fit in 64 bits, value is UINT64_MAX
+#define NUMBER_SUFFIX_F  0x04
+#define NUMBER_SUFFIX_U  0x08
+#define NUMBER_SUFFIX_L  0x10
+#define NUMBER_SUFFIX_LL 0x20
+
+typedef struct {
+    uint64_t value;
+    uint32_t flags;
+    int valid;
+    // for a bad literal, what is wrong and where, relative to its start
+    Diagnostic_code error;
+    size_t error_at, error_length;
+} Number;
+
+size_t number_scan(const char *text, size_t limit, Number *number);
+
+static inline double number_double(uint64_t value) {
+    double real;
+    memcpy(&real, &value, sizeof real);
+    return real;
+}
+
+#endif
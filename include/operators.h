@@ -0,0 +1,13 @@
+#ifndef _OPERATORS_
+#define _OPERATORS_
+#include <stddef.h>
+
+#include "lexer.h"
+
+// longest operator or punctuator, ... <<= and >>=
+#define OPERATOR_MAX_LEN 3
+
+void operator_table_initialize(void);
+size_t operator_match(const char *text, size_t length, TokenType *type);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef _PARALLEL_LEXER_
+#define _PARALLEL_LEXER_
+#include <stdlib.h>
+
+#include "lexer.h"
+#include "thread_pool.h"
+
+// inputs are only split when every chunk gets at least this many bytes
+#define PARALLEL_MIN_CHUNK (1024 * 1024)
+
+size_t lexer_scan_parallel(Lexer *lexer, Thread_pool *pool, size_t min_chunk);
+
+#endif
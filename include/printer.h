@@ -0,0 +1,42 @@
+#ifndef _PRINTER_
+#define _PRINTER_
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lexer.h"
+
+typedef enum {
+    PRINT_PRETTY, // the original columns, colored when asked to
+    PRINT_TSV,    // type, text, line, col separated by tabs
+    PRINT_JSONL,  // one JSON object per token
+} Print_format;
+
+// formats tokens into one reusable buffer that is handed to fwrite when
+// it fills up. with out == NULL nothing is written, the text stays in
+// buffer until printer_clear so the caller can place it itself
+typedef struct {
+    FILE *out;
+    Print_format format;
+    int color;
+    // jsonl records of identifiers carry their symbol id
+    int symbols;
+    char *buffer;
+    size_t used, capacity;
+    // position in the current row of the pretty layout
+    int chars_printed;
+    // get_token_name and its length, looked up once
+    const char *names[TOKEN_EOF + 1];
+    size_t name_lengths[TOKEN_EOF + 1];
+} Printer;
+
+void printer_initialize(Printer *printer, FILE *out, Print_format format, int color);
+void printer_token(Printer *printer, Lexer *lexer, const Token *token);
+void printer_tokens(Printer *printer, Lexer *lexer);
+void printer_end(Printer *printer);
+void printer_flush(Printer *printer);
+void printer_clear(Printer *printer);
+void printer_free(Printer *printer);
+
+void print_tokens(Lexer *lexer, FILE *out);
+
+#endif
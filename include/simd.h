@@ -0,0 +1,35 @@
+#ifndef _SIMD_
+#define _SIMD_
+#include <stddef.h>
+#include <stdint.h>
+
+// a run kernel returns how many bytes from the start of data belong to its
+// class, never looking past length. the vector versions classify a block
+// of 16 or 32 bytes per step and fall back to char_class for the tail
+typedef size_t (*Simd_run_fn)(const char *data, size_t length);
+
+// a block comment body: returns the index just past the first "*/", or
+// length if there is none
+typedef size_t (*Simd_block_fn)(const char *data, size_t length);
+
+// writes base + i + 1, the offset of the line that follows, for every
+// '\n' at data[i] and returns how many there were. starts must have room
+// for length entries
+typedef size_t (*Simd_lines_fn)(const char *data, size_t length, uint32_t base, uint32_t *starts);
+
+typedef struct {
+    Simd_run_fn space;   // CHAR_SPACE
+    Simd_run_fn ident;   // CHAR_IDENT
+    Simd_run_fn comment; // CHAR_COMMENT
+    Simd_block_fn block_comment;
+    Simd_lines_fn lines;
+    const char *name;
+} Simd_kernels;
+
+// picked once by simd_initialize from what the cpu supports, setting
+// LEXER_SIMD to scalar, sse2 or avx2 overrides the choice
+extern Simd_kernels simd;
+
+void simd_initialize(void);
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef _STATS_
+#define _STATS_
+#include <stdint.h>
+#include <stdio.h>
+
+#include "lexer.h"
+
+// optional counters around the hot paths, compiled in only with
+// -DLEXER_STATS (make STATS=1). without it every macro below expands to
+// nothing and the lexer pays nothing
+
+typedef enum {
+    STAT_IO,
+    STAT_WHITESPACE,
+    STAT_IDENTIFIER, // includes STAT_KEYWORD, STAT_INTERN and the STAT_CREATE_TOKEN of the word
+    STAT_KEYWORD,
+    STAT_INTERN,
+    STAT_NUMBER,
+    STAT_LITERAL,
+    STAT_COMMENT,
+    STAT_CREATE_TOKEN,
+    STAT_LINES,
+    STAT_PHASE_COUNT
+} Stat_phase;
+
+// one block per thread, summed when printed
+typedef struct Lexer_stats {
+    uint64_t ticks[STAT_PHASE_COUNT];
+    uint64_t calls[STAT_PHASE_COUNT];
+    uint64_t tokens[TOKEN_EOF + 1];
+    uint64_t bytes;
+    uint64_t allocations;
+    uint64_t allocated_bytes;
+    struct Lexer_stats *next;
+} Lexer_stats;
+
+int stats_enabled(void);
+void stats_print(FILE *out, int json, double seconds);
+
+#ifdef LEXER_STATS
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t stats_clock(void) { return __rdtsc(); }
+#else
+#include <time.h>
+static inline uint64_t stats_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+extern __thread Lexer_stats *stats_local;
+Lexer_stats *stats_register(void);
+
+static inline Lexer_stats *stats_thread(void) {
+    return stats_local ? stats_local : stats_register();
+}
+
+#define STATS_BEGIN(timer) uint64_t timer = stats_clock()
+#define STATS_END(timer, phase)                               \
+    do {                                                      \
+        Lexer_stats *stats_ = stats_thread();                 \
+        stats_->ticks[phase] += stats_clock() - (timer);      \
+        stats_->calls[phase]++;                               \
+    } while (0)
+#define STATS_TOKEN(type) (stats_thread()->tokens[type]++)
+#define STATS_BYTES(count) (stats_thread()->bytes += (count))
+#define STATS_ALLOC(size)                                     \
+    do {                                                      \
+        Lexer_stats *stats_ = stats_thread();                 \
+        stats_->allocations++;                                \
+        stats_->allocated_bytes += (size);                    \
+    } while (0)
+
+#else
+
+#define STATS_BEGIN(timer) ((void)0)
+#define STATS_END(timer, phase) ((void)0)
+#define STATS_TOKEN(type) ((void)0)
+#define STATS_BYTES(count) ((void)0)
+#define STATS_ALLOC(size) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef _THREAD_POOL_
+#define _THREAD_POOL_
+#include <pthread.h>
+#include <stdlib.h>
+
+typedef void (*Task_fn)(void *arg, int worker);
+
+typedef struct {
+    Task_fn fn;
+    void *arg;
+} Task;
+
+// per worker double ended queue. the owner pushes and pops at the bottom,
+// idle workers steal the oldest task from the top
+typedef struct {
+    pthread_mutex_t lock;
+    Task *tasks;
+    size_t top, bottom, capacity;
+} Task_deque;
+
+typedef struct {
+    int worker_count;
+    pthread_t *threads;
+    Task_deque *deques;
+
+    // tasks submitted but not finished, thread_pool_wait blocks on this
+    size_t pending;
+    // tasks sitting in some deque, idle workers sleep while this is zero
+    size_t queued;
+    int shutdown;
+    size_t next_deque;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_available;
+    pthread_cond_t all_done;
+} Thread_pool;
+
+int thread_pool_initialize(Thread_pool *pool, int worker_count);
+void thread_pool_submit(Thread_pool *pool, Task_fn fn, void *arg);
+void thread_pool_wait(Thread_pool *pool);
+void thread_pool_destroy(Thread_pool *pool);
+int thread_pool_worker_id(void);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef _TOKEN_BUFFER_
+#define _TOKEN_BUFFER_
+#include <stdint.h>
+#include <stdlib.h>
+
+// growable token storage split into parallel arrays, token i is
+// (types[i], offsets[i], lengths[i], payloads[i], values[i]). passes that
+// only need one field walk a single dense array. lines and cols are not
+// stored, see lexer_position
+typedef struct {
+    uint8_t *types;
+    uint32_t *offsets;
+    uint32_t *lengths;
+    // meaning depends on the type, see Token
+    uint32_t *payloads;
+    // the decoded value of a number literal, 0 for everything else
+    uint64_t *values;
+    size_t count, capacity;
+} Token_buffer;
+
+void token_buffer_initialize(Token_buffer *buffer);
+int token_buffer_reserve(Token_buffer *buffer, size_t capacity);
+size_t token_buffer_push(Token_buffer *buffer, uint8_t type, uint32_t offset, uint32_t length);
+int token_buffer_splice(Token_buffer *buffer, size_t index, size_t removed, const Token_buffer *source);
+void token_buffer_clear(Token_buffer *buffer);
+void token_buffer_free(Token_buffer *buffer);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _TOKEN_CACHE_
+#define _TOKEN_CACHE_
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "lexer.h"
+#include "token_file.h"
+
+// on disk cache of token streams. an entry is a token file named after a
+// hash of the source it was lexed from, seeded with LEXER_VERSION and
+// TOKEN_FILE_VERSION so entries of other builds are simply never found.
+// the token file holds the source as its string table, a hit is only
+// taken when that matches the input byte for byte, so a hash collision
+// costs a lex and never gives wrong tokens. entries are touched on every
+// hit and token_cache_trim drops the least recently used ones
+
+#define TOKEN_CACHE_DEFAULT_LIMIT (256 * 1024 * 1024)
+
+typedef struct {
+    char *dir;
+    // total size of the entries token_cache_trim keeps
+    size_t limit;
+    // permissions of a new entry, 0666 less the umask like any other file
+    mode_t mode;
+} Token_cache;
+
+typedef struct {
+    uint64_t hash;
+    // the mapped entry of a hit, see token_cache_lookup
+    Token_file file;
+} Token_cache_entry;
+
+uint64_t token_cache_hash(const void *data, size_t length, uint64_t seed);
+
+int token_cache_open(Token_cache *cache, const char *dir, size_t limit);
+int token_cache_lookup(Token_cache *cache, const char *source, size_t length, Token_cache_entry *entry);
+int token_cache_store(Token_cache *cache, Token_cache_entry *entry, Lexer *lexer);
+void token_cache_release(Token_cache_entry *entry);
+int token_cache_trim(Token_cache *cache);
+void token_cache_close(Token_cache *cache);
+
+#endif
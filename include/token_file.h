@@ -0,0 +1,53 @@
+#ifndef _TOKEN_FILE_
+#define _TOKEN_FILE_
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "lexer.h"
+
+// binary token dump: a header, the string table (the lexed source, token
+// offsets point into it) and fixed width token records. every section is
+// 8 byte aligned so a mapped file is used in place, there is no parsing.
+// multi byte fields are in the byte order of the writer, a reader on the
+// other order rejects the file
+
+#define TOKEN_FILE_MAGIC "CLEXTOK"
+// bump whenever the record layout or the TokenType numbering changes
+#define TOKEN_FILE_VERSION 3
+#define TOKEN_FILE_BYTE_ORDER 0x01020304u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint64_t token_count;
+    uint64_t strings_offset, strings_size;
+    uint64_t records_offset;
+} Token_file_header;
+
+// lines and cols are found from the string table, see lexer_position
+typedef struct {
+    uint32_t offset, length;
+    uint8_t type;
+    uint8_t reserved[3];
+} Token_record;
+
+typedef struct {
+    const Token_file_header *header;
+    const char *strings;
+    const Token_record *records;
+    size_t count;
+    // the whole mapping
+    void *data;
+    size_t size;
+} Token_file;
+
+int token_file_write(int fd, Lexer *lexer);
+int token_file_open(const char *path, Token_file *file);
+int token_file_map(const void *data, size_t size, Token_file *file);
+int token_file_load(const Token_file *file, Lexer *lexer);
+void token_file_close(Token_file *file);
+
+#endif
@@ -0,0 +1,79 @@
+#include "arena.h"
+#include "stats.h"
+
+#define ARENA_ALIGN (sizeof(max_align_t))
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static Arena_chunk *chunk_create(size_t capacity) {
+    Arena_chunk *chunk = malloc(sizeof(Arena_chunk) + capacity);
+    if (!chunk) return NULL;
+    STATS_ALLOC(sizeof(Arena_chunk) + capacity);
+
+    chunk->next = NULL;
+    chunk->used = 0;
+    chunk->capacity = capacity;
+    return chunk;
+}
+
+void arena_initialize(Arena *arena) {
+    arena->first = NULL;
+    arena->current = NULL;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = align_up(size);
+
+    Arena_chunk *chunk = arena->current;
+    // walk into chunks kept by a previous reset before asking malloc for more
+    while (chunk && chunk->capacity - chunk->used < size) {
+        if (!chunk->next) {
+            break;
+        }
+
+        chunk = chunk->next;
+        chunk->used = 0;
+    }
+
+    if (!chunk || chunk->capacity - chunk->used < size) {
+        size_t capacity = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        Arena_chunk *fresh = chunk_create(capacity);
+        if (!fresh) return NULL;
+
+        if (chunk) {
+            chunk->next = fresh;
+        } else {
+            arena->first = fresh;
+        }
+        chunk = fresh;
+    }
+
+    arena->current = chunk;
+
+    void *ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+void arena_reset(Arena *arena) {
+    // chunks past the first are rewound lazily as arena_alloc reaches them
+    arena->current = arena->first;
+    if (arena->first) {
+        arena->first->used = 0;
+    }
+}
+
+void arena_free(Arena *arena) {
+    Arena_chunk *chunk = arena->first;
+
+    while (chunk) {
+        Arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena->first = NULL;
+    arena->current = NULL;
+}
@@ -0,0 +1,32 @@
+#include "char_class.h"
+
+// anything that may sit inside a literal or comment, that is everything
+// but NUL, newline, 0xff (EOF as a char) and the closing quote
+#define BODY (CHAR_STRING | CHAR_CHAR | CHAR_COMMENT)
+#define LETTER (BODY | CHAR_ALPHA | CHAR_IDENT | CHAR_NUMBER)
+#define DIGIT (BODY | CHAR_DIGIT | CHAR_IDENT | CHAR_NUMBER | CHAR_HEX)
+
+const uint16_t char_class[256] = {
+    [0x01 ... 0x08] = BODY,
+    ['\t'] = BODY | CHAR_SPACE,
+    [0x0b ... 0x0d] = BODY | CHAR_SPACE,
+    [0x0e ... 0x1f] = BODY,
+    [' '] = BODY | CHAR_SPACE,
+    ['!'] = BODY,
+    ['"'] = CHAR_CHAR | CHAR_COMMENT,
+    ['#' ... '&'] = BODY,
+    ['\''] = CHAR_STRING | CHAR_COMMENT,
+    ['(' ... '-'] = BODY,
+    ['.'] = BODY | CHAR_NUMBER,
+    ['/'] = BODY,
+    ['0' ... '9'] = DIGIT,
+    [':' ... '@'] = BODY,
+    ['A' ... 'F'] = LETTER | CHAR_HEX,
+    ['G' ... 'Z'] = LETTER,
+    ['[' ... '^'] = BODY,
+    ['_'] = BODY | CHAR_IDENT,
+    ['`'] = BODY,
+    ['a' ... 'f'] = LETTER | CHAR_HEX,
+    ['g' ... 'z'] = LETTER,
+    ['{' ... 0xfe] = BODY,
+};
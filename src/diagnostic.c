@@ -0,0 +1,103 @@
+#include "diagnostic.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void diagnostic_list_initialize(Diagnostic_list *list) {
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+static int diagnostic_list_reserve(Diagnostic_list *list, size_t capacity) {
+    if (capacity <= list->capacity) return 0;
+
+    size_t grown_capacity = list->capacity ? list->capacity * 2 : 16;
+    if (grown_capacity < capacity) grown_capacity = capacity;
+
+    Diagnostic *items = realloc(list->items, sizeof(Diagnostic) * grown_capacity);
+    if (!items) return -1;
+
+    list->items = items;
+    list->capacity = grown_capacity;
+    return 0;
+}
+
+// a new zeroed entry at the end, errors are rare so running out of
+// memory here is treated like anywhere else in the lexer
+Diagnostic *diagnostic_list_push(Diagnostic_list *list) {
+    if (diagnostic_list_reserve(list, list->count + 1) < 0) {
+        perror("diagnostic_list_push");
+        exit(EXIT_FAILURE);
+    }
+
+    Diagnostic *diagnostic = &list->items[list->count++];
+    memset(diagnostic, 0, sizeof(Diagnostic));
+    return diagnostic;
+}
+
+// replace [index, index + removed) with count items, like token_buffer_splice
+int diagnostic_list_splice(Diagnostic_list *list, size_t index, size_t removed,
+                           const Diagnostic *items, size_t count) {
+    size_t total = list->count - removed + count;
+    if (diagnostic_list_reserve(list, total) < 0) return -1;
+
+    // an empty list may have no array yet
+    if (total == 0 && list->count == 0) return 0;
+
+    memmove(list->items + index + count, list->items + index + removed,
+            (list->count - index - removed) * sizeof(Diagnostic));
+    if (count > 0) {
+        memcpy(list->items + index, items, count * sizeof(Diagnostic));
+    }
+
+    list->count = total;
+    return 0;
+}
+
+void diagnostic_list_clear(Diagnostic_list *list) { list->count = 0; }
+
+void diagnostic_list_free(Diagnostic_list *list) {
+    free(list->items);
+    diagnostic_list_initialize(list);
+}
+
+const char *get_diagnostic_name(Diagnostic_code code) {
+    switch (code) {
+        case DIAGNOSTIC_NUMBER_SUFFIX:
+            return "number-suffix";
+
+        case DIAGNOSTIC_HEX_DIGIT:
+            return "hex-digit";
+
+        case DIAGNOSTIC_BINARY_DIGIT:
+            return "binary-digit";
+
+        case DIAGNOSTIC_OCTAL_DIGIT:
+            return "octal-digit";
+
+        case DIAGNOSTIC_NUMBER_CHARACTER:
+            return "number-character";
+
+        case DIAGNOSTIC_UNTERMINATED_STRING:
+            return "unterminated-string";
+
+        case DIAGNOSTIC_UNTERMINATED_CHAR:
+            return "unterminated-char";
+
+        case DIAGNOSTIC_MULTI_CHAR:
+            return "multi-char";
+
+        case DIAGNOSTIC_UNTERMINATED_COMMENT:
+            return "unterminated-comment";
+
+        default:
+            return "unknown";
+    }
+}
+
+// path:line:col: error: message [code], the form editors and CI parse
+void diagnostic_print(FILE *out, const char *path, const Diagnostic *diagnostic) {
+    fprintf(out, "%s:%u:%u: error: %s [%s]\n", path, diagnostic->line, diagnostic->col,
+            diagnostic->message, get_diagnostic_name(diagnostic->code));
+}
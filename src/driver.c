@@ -0,0 +1,610 @@
+#define _GNU_SOURCE
+#include "driver.h"
+
+#include <errno.h>
+#include <ftw.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "input.h"
+#include "lexer.h"
+#include "parallel_lexer.h"
+#include "printer.h"
+#include "thread_pool.h"
+#include "token_cache.h"
+#include "token_file.h"
+
+// what was formatted for one input while it waits for the inputs before
+// it, see emit_reports
+typedef struct {
+    char *messages;
+    size_t messages_length;
+    char *output;
+    size_t output_length;
+    int done;
+} Driver_report;
+
+typedef struct {
+    Driver_file_list *list;
+    Driver_options *options;
+    // one lexer per worker, reset between files so its buffers are reused
+    Lexer *lexers;
+    // one collecting printer per worker, its buffer is reused as well
+    Printer *printers;
+    // set when a single input is split across the whole pool instead
+    Thread_pool *split_pool;
+    // headers reached by #include are lexed here
+    Thread_pool *pool;
+    pthread_mutex_t output_lock;
+    // one per input, reports[0..next_report) are written out already
+    Driver_report *reports;
+    size_t next_report;
+    // #include directives followed, and the ones no search path had
+    size_t includes, unresolved;
+} Driver;
+
+typedef struct {
+    Driver *driver;
+    Driver_file *file;
+} Driver_job;
+
+typedef struct {
+    Driver *driver;
+    Header *header;
+} Header_job;
+
+void driver_file_list_initialize(Driver_file_list *list) {
+    list->files = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+static int list_append(Driver_file_list *list, const char *path, size_t bytes) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 64;
+        Driver_file *files = realloc(list->files, sizeof(Driver_file) * capacity);
+        if (!files) return -1;
+
+        list->files = files;
+        list->capacity = capacity;
+    }
+
+    Driver_file *file = &list->files[list->count];
+    file->path = strdup(path);
+    if (!file->path) return -1;
+
+    file->bytes = bytes;
+    file->tokens = 0;
+    file->error = 0;
+    file->cached = 0;
+    file->errors = 0;
+    file->includes = 0;
+    file->header = NULL;
+    list->count++;
+    return 0;
+}
+
+static int is_source_file(const char *path) {
+    const char *dot = strrchr(path, '.');
+    return dot && (strcmp(dot, ".c") == 0 || strcmp(dot, ".h") == 0);
+}
+
+static int is_header_file(const char *path) {
+    const char *dot = strrchr(path, '.');
+    return dot && strcmp(dot, ".h") == 0;
+}
+
+// nftw has no user pointer, directory walks are only done from the main thread
+static Driver_file_list *walk_list;
+
+static int walk_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)ftw;
+
+    if (type == FTW_F && S_ISREG(st->st_mode) && is_source_file(path)) {
+        if (list_append(walk_list, path, st->st_size) < 0) return -1;
+    }
+
+    return 0;
+}
+
+// directories are searched recursively for .c and .h files, anything
+// else is taken as is
+int driver_add_path(Driver_file_list *list, const char *path) {
+    struct stat st;
+    if (strcmp(path, "-") != 0 && stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        walk_list = list;
+        int result = nftw(path, walk_entry, 64, FTW_PHYS);
+        walk_list = NULL;
+        return result;
+    }
+
+    size_t bytes = 0;
+    if (strcmp(path, "-") != 0 && stat(path, &st) == 0) {
+        bytes = st.st_size;
+    }
+
+    return list_append(list, path, bytes);
+}
+
+// one path per line, "-" reads the list from stdin
+int driver_add_list_file(Driver_file_list *list, const char *list_path) {
+    FILE *fp = strcmp(list_path, "-") == 0 ? stdin : fopen(list_path, "r");
+    if (!fp) return -1;
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t line_len;
+    int result = 0;
+
+    while ((line_len = getline(&line, &line_capacity, fp)) != -1) {
+        while (line_len > 0 && (line[line_len - 1] == '\n' || line[line_len - 1] == '\r')) {
+            line[--line_len] = '\0';
+        }
+
+        if (line_len == 0) continue;
+
+        if (driver_add_path(list, line) < 0) {
+            result = -1;
+            break;
+        }
+    }
+
+    free(line);
+    if (fp != stdin) fclose(fp);
+    return result;
+}
+
+void driver_file_list_free(Driver_file_list *list) {
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->files[i].path);
+    }
+
+    free(list->files);
+    driver_file_list_initialize(list);
+}
+
+// fills lexer, already set to its source, with the tokens. they come
+// from the token cache when it has them: a count needs only the entry
+// header, anything that reads the tokens copies its records. an entry
+// that fails to open or load is a miss, the file is lexed again and the
+// entry rewritten
+static size_t lex_source(Driver *driver, Lexer *lexer, Thread_pool *split_pool, int *cached) {
+    Driver_options *options = driver->options;
+    Token_cache *cache = options->cache;
+    int load = options->print || options->symbols || options->headers;
+    size_t tokens;
+
+    Token_cache_entry entry;
+    if (cache && token_cache_lookup(cache, lexer->source, lexer->length, &entry) &&
+        (!load || token_file_load(&entry.file, lexer) == 0)) {
+        tokens = entry.file.count;
+        token_cache_release(&entry);
+        *cached = 1;
+        return tokens;
+    }
+
+    if (split_pool) {
+        tokens = lexer_scan_parallel(lexer, split_pool, PARALLEL_MIN_CHUNK);
+    } else {
+        tokens = lexer_scan_all(lexer);
+    }
+
+    // a failed store only costs a lex next time. entries hold no
+    // diagnostics, a file with errors is lexed again every run so they
+    // are reported every time
+    if (cache) {
+        token_cache_release(&entry);
+        if (lexer->diagnostics.count == 0) {
+            token_cache_store(cache, &entry, lexer);
+        }
+    }
+
+    *cached = 0;
+    return tokens;
+}
+
+// writes out, in input order, every finished report no earlier input is
+// still waiting for. called with output_lock held
+static void emit_reports(Driver *driver) {
+    while (driver->next_report < driver->list->count && driver->reports[driver->next_report].done) {
+        Driver_report *report = &driver->reports[driver->next_report++];
+
+        // the tokens of the files before go out first when both streams
+        // end up in the same place
+        if (report->messages_length > 0) {
+            fflush(stdout);
+            fwrite(report->messages, 1, report->messages_length, stderr);
+        }
+        fwrite(report->output, 1, report->output_length, stdout);
+        free(report->messages);
+        free(report->output);
+        report->messages = report->output = NULL;
+    }
+}
+
+static void finish_report(Driver *driver, Driver_report *report) {
+    pthread_mutex_lock(&driver->output_lock);
+    report->done = 1;
+    emit_reports(driver);
+    pthread_mutex_unlock(&driver->output_lock);
+}
+
+// the "==> path <==" block of a lexed file, formatted with printer
+static char *format_tokens(Printer *printer, const char *path, Lexer *lexer, size_t *length) {
+    printer_tokens(printer, lexer);
+    printer_end(printer);
+
+    size_t header = strlen(path) + sizeof "==>  <==\n" - 1;
+    char *output = malloc(header + printer->used);
+    if (!output) {
+        perror("driver");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(output, header + 1, "==> %s <==\n", path);
+    memcpy(output + header, printer->buffer, printer->used);
+    *length = header + printer->used;
+
+    printer_clear(printer);
+    return output;
+}
+
+// formats the diagnostics and, when asked to, the tokens of a lexed file
+// into report. the files finish in any order but go out in input order,
+// so two runs print the same. returns the number of diagnostics
+static size_t report_file(Driver *driver, int worker, Driver_report *report, const char *path,
+                          Lexer *lexer) {
+    size_t errors = lexer->diagnostics.count;
+    if (errors > 0) {
+        FILE *messages = open_memstream(&report->messages, &report->messages_length);
+        if (!messages) {
+            perror("driver");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < errors; i++) {
+            diagnostic_print(messages, path, &lexer->diagnostics.items[i]);
+        }
+        fclose(messages);
+    }
+
+    if (driver->options->print) {
+        // format privately first so concurrent files dont interleave
+        report->output = format_tokens(&driver->printers[worker], path, lexer, &report->output_length);
+    }
+
+    finish_report(driver, report);
+    return errors;
+}
+
+static void lex_header(void *arg, int worker);
+
+// claims the headers the file at path includes, the ones nobody claimed
+// before are lexed on the pool. returns how many includes were found
+static size_t follow_includes(Driver *driver, const char *path, Lexer *lexer) {
+    Header_cache *headers = driver->options->headers;
+    size_t found = 0, missing = 0;
+    size_t index = 0;
+    Include include;
+    char resolved[PATH_MAX];
+
+    while (include_next(lexer, &index, &include)) {
+        if (header_cache_resolve(headers, path, &include, resolved, sizeof resolved) < 0) {
+            missing++;
+            continue;
+        }
+        found++;
+
+        int created;
+        Header *header = header_cache_claim(headers, resolved, &created);
+        if (!header) {
+            perror("header_cache_claim");
+            exit(EXIT_FAILURE);
+        }
+        if (!created) continue;
+
+        Header_job *job = malloc(sizeof(Header_job));
+        if (!job) {
+            perror("follow_includes");
+            exit(EXIT_FAILURE);
+        }
+        job->driver = driver;
+        job->header = header;
+        thread_pool_submit(driver->pool, lex_header, job);
+    }
+
+    __atomic_fetch_add(&driver->includes, found, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&driver->unresolved, missing, __ATOMIC_RELAXED);
+    return found;
+}
+
+// a header only reached by #include. its lexer is its own and is left
+// alone once the header is lexed, every includer shares it. it is
+// reported after the inputs, in path order
+static void lex_header(void *arg, int worker) {
+    (void)worker;
+    Header_job *job = arg;
+    Driver *driver = job->driver;
+    Header *header = job->header;
+    free(job);
+
+    if (source_file_open(header->path, &header->source) < 0) {
+        header->error = errno;
+        return;
+    }
+
+    Lexer *lexer = &header->lexer;
+    lexer_set_symbols(lexer, driver->options->symbols);
+    lexer_set_source(lexer, header->source.data, header->source.length);
+    lex_source(driver, lexer, NULL, &header->cached);
+    follow_includes(driver, header->path, lexer);
+}
+
+static void lex_file(void *arg, int worker) {
+    Driver_job *job = arg;
+    Driver *driver = job->driver;
+    Driver_file *file = job->file;
+    Driver_report *report = &driver->reports[file - driver->list->files];
+
+    // an input that is a header is kept in the header cache like one
+    // reached by #include, other inputs reuse the worker's lexer
+    Header *header = file->header;
+    Lexer *lexer = header ? &header->lexer : &driver->lexers[worker];
+    Source_file own;
+    Source_file *source = header ? &header->source : &own;
+
+    if (source_file_open(file->path, source) < 0) {
+        file->error = errno;
+        if (header) header->error = errno;
+        finish_report(driver, report);
+        return;
+    }
+
+    if (header) {
+        lexer_set_symbols(lexer, driver->options->symbols);
+    } else {
+        lexer_reset(lexer);
+    }
+    lexer_set_source(lexer, source->data, source->length);
+    file->bytes = source->length;
+
+    file->tokens = lex_source(driver, lexer, driver->split_pool, &file->cached);
+    file->errors = report_file(driver, worker, report, file->path, lexer);
+    if (driver->options->headers) {
+        file->includes = follow_includes(driver, file->path, lexer);
+    }
+
+    if (header) {
+        header->cached = file->cached;
+    } else {
+        source_file_close(source);
+    }
+}
+
+static int compare_size(const void *a, const void *b) {
+    const Driver_file *fa = ((const Driver_job *)a)->file;
+    const Driver_file *fb = ((const Driver_job *)b)->file;
+    return (fa->bytes > fb->bytes) - (fa->bytes < fb->bytes);
+}
+
+static int compare_header_path(const void *a, const void *b) {
+    return strcmp((*(Header *const *)a)->path, (*(Header *const *)b)->path);
+}
+
+// header inputs take their entry in the header cache up front, so a
+// header that is both an input and included is still lexed only once
+static void claim_header_inputs(Driver_file_list *list, Header_cache *headers) {
+    char resolved[PATH_MAX];
+
+    for (size_t i = 0; i < list->count; i++) {
+        Driver_file *file = &list->files[i];
+        if (!is_header_file(file->path) || !realpath(file->path, resolved)) continue;
+
+        // the same file given twice is lexed as a plain input the second time
+        int created;
+        Header *header = header_cache_claim(headers, resolved, &created);
+        if (!header) {
+            perror("header_cache_claim");
+            exit(EXIT_FAILURE);
+        }
+        if (!created) continue;
+
+        header->input = 1;
+        file->header = header;
+    }
+}
+
+static double elapsed_seconds(struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int driver_run(Driver_file_list *list, Driver_options *options) {
+    Driver driver;
+    driver.list = list;
+    driver.options = options;
+    driver.split_pool = NULL;
+    driver.pool = NULL;
+    driver.includes = 0;
+    driver.unresolved = 0;
+    driver.next_report = 0;
+    pthread_mutex_init(&driver.output_lock, NULL);
+
+    int jobs = options->jobs > 0 ? options->jobs : 1;
+    driver.lexers = malloc(sizeof(Lexer) * jobs);
+    driver.printers = malloc(sizeof(Printer) * jobs);
+    Driver_job *work = malloc(sizeof(Driver_job) * (list->count ? list->count : 1));
+    driver.reports = calloc(list->count ? list->count : 1, sizeof(Driver_report));
+    if (!driver.lexers || !driver.printers || !work || !driver.reports) {
+        perror("driver_run");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < jobs; i++) {
+        lexer_initialize(&driver.lexers[i]);
+        lexer_set_symbols(&driver.lexers[i], options->symbols);
+        printer_initialize(&driver.printers[i], NULL, options->format, options->color);
+        driver.printers[i].symbols = options->symbols != NULL;
+    }
+
+    for (size_t i = 0; i < list->count; i++) {
+        work[i].driver = &driver;
+        work[i].file = &list->files[i];
+    }
+
+    if (options->headers) {
+        claim_header_inputs(list, options->headers);
+    }
+
+    // smallest first, each worker pops the newest task from its own deque so
+    // the big files get started early and thieves pick up the small ones.
+    // diagnostics and printed tokens still go out in input order, a file
+    // that finishes early waits in its report for the ones before it
+    qsort(work, list->count, sizeof(Driver_job), compare_size);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    Thread_pool pool;
+    if (thread_pool_initialize(&pool, jobs) < 0) {
+        perror("thread_pool_initialize");
+        exit(EXIT_FAILURE);
+    }
+    driver.pool = &pool;
+
+    if (list->count == 1 && jobs > 1) {
+        // one big input, split it by lines and lex the pieces on the pool.
+        // the headers it includes are only queued once that is done
+        driver.split_pool = &pool;
+        lex_file(&work[0], 0);
+    }
+    else {
+        for (size_t i = 0; i < list->count; i++) {
+            thread_pool_submit(&pool, lex_file, &work[i]);
+        }
+    }
+
+    thread_pool_wait(&pool);
+    thread_pool_destroy(&pool);
+
+    double seconds = elapsed_seconds(&start);
+
+    size_t total_bytes = 0;
+    size_t total_tokens = 0;
+    size_t failed = 0;
+    size_t cached = 0;
+    size_t errors = 0;
+
+    for (size_t i = 0; i < list->count; i++) {
+        Driver_file *file = &list->files[i];
+
+        if (file->error) {
+            fprintf(stderr, "%s: %s\n", file->path, strerror(file->error));
+            failed++;
+            continue;
+        }
+
+        if (!options->print) {
+            printf("%zu\t%s\n", file->tokens, file->path);
+        }
+
+        total_bytes += file->bytes;
+        total_tokens += file->tokens;
+        cached += file->cached;
+        errors += file->errors;
+    }
+
+    // headers reached only by #include follow the inputs, by path since
+    // they were found in whatever order the workers got to them
+    size_t header_count = 0;
+    if (options->headers) {
+        Header_cache *headers = options->headers;
+        Header **reached = malloc(sizeof(Header *) * (headers->count ? headers->count : 1));
+        if (!reached) {
+            perror("driver_run");
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t i = 0; i < headers->count; i++) {
+            if (!headers->headers[i]->input) reached[header_count++] = headers->headers[i];
+        }
+        qsort(reached, header_count, sizeof(Header *), compare_header_path);
+
+        for (size_t i = 0; i < header_count; i++) {
+            Header *header = reached[i];
+
+            if (header->error) {
+                fprintf(stderr, "%s: %s\n", header->path, strerror(header->error));
+                failed++;
+                continue;
+            }
+
+            if (header->lexer.diagnostics.count > 0) fflush(stdout);
+            for (size_t j = 0; j < header->lexer.diagnostics.count; j++) {
+                diagnostic_print(stderr, header->path, &header->lexer.diagnostics.items[j]);
+            }
+
+            if (options->print) {
+                size_t length;
+                char *output = format_tokens(&driver.printers[0], header->path, &header->lexer, &length);
+                fwrite(output, 1, length, stdout);
+                free(output);
+            }
+            else {
+                printf("%zu\t%s\n", header->lexer.tokens.count, header->path);
+            }
+
+            total_bytes += header->source.length;
+            total_tokens += header->lexer.tokens.count;
+            cached += header->cached;
+            errors += header->lexer.diagnostics.count;
+        }
+
+        free(reached);
+    }
+    size_t lexed = list->count + header_count - failed;
+
+    if (seconds <= 0) seconds = 1e-9;
+    fflush(stdout);
+    fprintf(stderr,
+            "lexed %zu files, %.2f MB, %zu tokens in %.3fs on %d threads "
+            "(%.1f MB/s, %.2f Mtokens/s)\n",
+            lexed, total_bytes / 1e6, total_tokens, seconds, jobs,
+            total_bytes / 1e6 / seconds, total_tokens / 1e6 / seconds);
+
+    if (errors > 0) {
+        fprintf(stderr, "%zu errors\n", errors);
+    }
+
+    if (options->symbols) {
+        fprintf(stderr, "%zu distinct identifiers\n", intern_count(options->symbols));
+    }
+
+    if (options->headers) {
+        fprintf(stderr, "followed %zu includes to %zu headers, %zu not found\n", driver.includes,
+                header_count, driver.unresolved);
+    }
+
+    if (options->cache) {
+        fprintf(stderr, "token cache: %zu hits, %zu misses\n", cached, lexed - cached);
+        if (token_cache_trim(options->cache) < 0) {
+            perror(options->cache->dir);
+        }
+    }
+
+    for (int i = 0; i < jobs; i++) {
+        lexer_cleanup(&driver.lexers[i]);
+        printer_free(&driver.printers[i]);
+    }
+
+    free(driver.lexers);
+    free(driver.printers);
+    free(work);
+    free(driver.reports);
+    pthread_mutex_destroy(&driver.output_lock);
+
+    return failed || errors ? -1 : 0;
+}
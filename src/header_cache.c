@@ -0,0 +1,265 @@
+#define _GNU_SOURCE
+#include "header_cache.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define HEADER_CACHE_MIN_SLOTS 64
+
+int header_cache_initialize(Header_cache *cache) {
+    cache->dirs = NULL;
+    cache->dir_count = cache->dir_capacity = 0;
+
+    cache->slots = calloc(HEADER_CACHE_MIN_SLOTS, sizeof(Header *));
+    if (!cache->slots) return -1;
+    cache->mask = HEADER_CACHE_MIN_SLOTS - 1;
+
+    cache->headers = NULL;
+    cache->count = cache->capacity = 0;
+    pthread_mutex_init(&cache->lock, NULL);
+    return 0;
+}
+
+// appended to the search path, not thread safe, meant to be called
+// before any lexing starts
+int header_cache_add_dir(Header_cache *cache, const char *dir) {
+    if (cache->dir_count == cache->dir_capacity) {
+        size_t capacity = cache->dir_capacity ? cache->dir_capacity * 2 : 8;
+        char **dirs = realloc(cache->dirs, sizeof(char *) * capacity);
+        if (!dirs) return -1;
+
+        cache->dirs = dirs;
+        cache->dir_capacity = capacity;
+    }
+
+    // "dir/" and "dir" search the same place
+    size_t length = strlen(dir);
+    while (length > 1 && dir[length - 1] == '/') length--;
+
+    char *copy = strndup(dir, length);
+    if (!copy) return -1;
+
+    cache->dirs[cache->dir_count++] = copy;
+    return 0;
+}
+
+// 1 and the canonical path of dir/name if that is a regular file
+static int try_path(const char *dir, size_t dir_length, const char *name, size_t length, char *path,
+                    size_t size) {
+    char candidate[PATH_MAX];
+    int written = dir ? snprintf(candidate, sizeof candidate, "%.*s/%.*s", (int)dir_length, dir,
+                                 (int)length, name)
+                      : snprintf(candidate, sizeof candidate, "%.*s", (int)length, name);
+    if (written < 0 || (size_t)written >= sizeof candidate) return 0;
+
+    char resolved[PATH_MAX];
+    if (!realpath(candidate, resolved)) return 0;
+
+    struct stat st;
+    if (stat(resolved, &st) < 0 || !S_ISREG(st.st_mode)) return 0;
+
+    size_t resolved_length = strlen(resolved);
+    if (resolved_length >= size) return 0;
+
+    memcpy(path, resolved, resolved_length + 1);
+    return 1;
+}
+
+// finds the file an include of includer names. "..." is looked up next
+// to includer first, then like <...> in the search paths. the result is
+// canonical so every way of reaching a header gives the same key. returns
+// -1 with errno ENOENT when no directory has it
+int header_cache_resolve(Header_cache *cache, const char *includer, const Include *include, char *path,
+                         size_t size) {
+    if (include->name[0] == '/') {
+        if (try_path(NULL, 0, include->name, include->length, path, size)) return 0;
+
+        errno = ENOENT;
+        return -1;
+    }
+
+    if (!include->angled) {
+        const char *slash = strrchr(includer, '/');
+        int found = slash ? try_path(includer, slash - includer, include->name, include->length, path, size)
+                          : try_path(".", 1, include->name, include->length, path, size);
+        if (found) return 0;
+    }
+
+    for (size_t i = 0; i < cache->dir_count; i++) {
+        const char *dir = cache->dirs[i];
+        if (try_path(dir, strlen(dir), include->name, include->length, path, size)) return 0;
+    }
+
+    errno = ENOENT;
+    return -1;
+}
+
+// fnv-1a, paths are short and only hashed once per include
+static uint64_t path_hash(const char *path) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+        hash = (hash ^ *p) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static Header **find_slot(Header **slots, size_t mask, const char *path) {
+    for (size_t i = path_hash(path) & mask;; i = (i + 1) & mask) {
+        if (!slots[i] || strcmp(slots[i]->path, path) == 0) return &slots[i];
+    }
+}
+
+static int grow_slots(Header_cache *cache) {
+    size_t capacity = (cache->mask + 1) * 2;
+    Header **slots = calloc(capacity, sizeof(Header *));
+    if (!slots) return -1;
+
+    for (size_t i = 0; i < cache->count; i++) {
+        *find_slot(slots, capacity - 1, cache->headers[i]->path) = cache->headers[i];
+    }
+
+    free(cache->slots);
+    cache->slots = slots;
+    cache->mask = capacity - 1;
+    return 0;
+}
+
+static Header *header_create(Header_cache *cache, const char *path) {
+    if (cache->count == cache->capacity) {
+        size_t capacity = cache->capacity ? cache->capacity * 2 : 64;
+        Header **headers = realloc(cache->headers, sizeof(Header *) * capacity);
+        if (!headers) return NULL;
+
+        cache->headers = headers;
+        cache->capacity = capacity;
+    }
+
+    Header *header = calloc(1, sizeof(Header));
+    if (!header) return NULL;
+
+    header->path = strdup(path);
+    if (!header->path) {
+        free(header);
+        return NULL;
+    }
+
+    lexer_initialize(&header->lexer);
+    cache->headers[cache->count++] = header;
+    return header;
+}
+
+// the header of a resolved path. the first caller for a path gets
+// *created set and has to fill the header in, everyone after that shares
+// it. returns NULL with errno set if memory runs out
+Header *header_cache_claim(Header_cache *cache, const char *path, int *created) {
+    pthread_mutex_lock(&cache->lock);
+
+    Header **slot = find_slot(cache->slots, cache->mask, path);
+    if (*slot) {
+        pthread_mutex_unlock(&cache->lock);
+        *created = 0;
+        return *slot;
+    }
+
+    // at most half full
+    if ((cache->count + 1) * 2 > cache->mask + 1) {
+        if (grow_slots(cache) < 0) {
+            pthread_mutex_unlock(&cache->lock);
+            return NULL;
+        }
+        slot = find_slot(cache->slots, cache->mask, path);
+    }
+
+    Header *header = header_create(cache, path);
+    if (header) {
+        *slot = header;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+    *created = header != NULL;
+    return header;
+}
+
+void header_cache_free(Header_cache *cache) {
+    for (size_t i = 0; i < cache->count; i++) {
+        Header *header = cache->headers[i];
+        lexer_cleanup(&header->lexer);
+        if (header->source.data) {
+            source_file_close(&header->source);
+        }
+        free(header->path);
+        free(header);
+    }
+
+    for (size_t i = 0; i < cache->dir_count; i++) {
+        free(cache->dirs[i]);
+    }
+
+    free(cache->dirs);
+    free(cache->slots);
+    free(cache->headers);
+    pthread_mutex_destroy(&cache->lock);
+}
+
+// the '#' of a directive is the first token on its line
+static int starts_line(Lexer *lexer, size_t index) {
+    if (index == 0) return 1;
+
+    Token_buffer *tokens = &lexer->tokens;
+    uint32_t end = tokens->offsets[index - 1] + tokens->lengths[index - 1];
+    return memchr(lexer->source + (end - lexer->base), '\n', tokens->offsets[index] - end) != NULL;
+}
+
+// walks the tokens from *index on to the next #include and moves *index
+// past it, returns 0 once there are no more. <...> is lexed as ordinary
+// tokens, its name is the source text up to the '>' on the same line
+int include_next(Lexer *lexer, size_t *index, Include *include) {
+    Token_buffer *tokens = &lexer->tokens;
+
+    for (size_t i = *index; i + 2 < tokens->count; i++) {
+        if (tokens->types[i] != TOKEN_HASHTAG || tokens->types[i + 1] != TOKEN_KEYWORD ||
+            tokens->lengths[i + 1] != 7 || !starts_line(lexer, i)) {
+            continue;
+        }
+
+        const char *keyword = lexer->source + (tokens->offsets[i + 1] - lexer->base);
+        if (memcmp(keyword, "include", 7) != 0) continue;
+
+        size_t name = i + 2;
+        include->offset = tokens->offsets[i];
+
+        if (tokens->types[name] == TOKEN_DOUBLE_QUOTE && name + 2 < tokens->count &&
+            tokens->types[name + 1] == TOKEN_STRING_LITERAL && tokens->lengths[name + 1] > 0) {
+            include->name = lexer->source + (tokens->offsets[name + 1] - lexer->base);
+            include->length = tokens->lengths[name + 1];
+            include->angled = 0;
+            *index = name + 3;
+            return 1;
+        }
+
+        if (tokens->types[name] == TOKEN_L_ANGLE_BRACE) {
+            const char *start = lexer->source + (tokens->offsets[name] - lexer->base) + 1;
+            size_t rest = lexer->length - (start - lexer->source);
+            const char *newline = memchr(start, '\n', rest);
+            const char *close = memchr(start, '>', newline ? (size_t)(newline - start) : rest);
+            if (!close || close == start) continue;
+
+            include->name = start;
+            include->length = close - start;
+            include->angled = 1;
+
+            uint32_t end = lexer->base + (close - lexer->source) + 1;
+            size_t next = name + 1;
+            while (next < tokens->count && tokens->offsets[next] < end) next++;
+            *index = next;
+            return 1;
+        }
+    }
+
+    *index = tokens->count;
+    return 0;
+}
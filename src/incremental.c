@@ -0,0 +1,210 @@
+#include "incremental.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+// like the parallel lexer this relies on a lexer being fully described by
+// its position. re-lexing starts at the last lexer_scan call that began
+// before the edit and stops as soon as a new call starts, past the edit,
+// at an offset where an old call started too. every old token from there
+// on is still right once its offset is shifted. lines and cols are not
+// stored, only the line index of the text is patched
+
+int incremental_initialize(Incremental_lexer *inc, const char *text, size_t length) {
+    inc->capacity = length > 0 ? length : 1;
+    inc->text = malloc(inc->capacity);
+    if (!inc->text) return -1;
+
+    memcpy(inc->text, text, length);
+    inc->length = length;
+
+    lexer_initialize(&inc->lexer);
+    lexer_initialize(&inc->scratch);
+    lexer_set_source(&inc->lexer, inc->text, inc->length);
+    lexer_scan_all(&inc->lexer);
+    return 0;
+}
+
+// intern the identifiers of the current and all later token streams
+void incremental_set_symbols(Incremental_lexer *inc, Intern_table *symbols) {
+    lexer_set_symbols(&inc->lexer, symbols);
+    lexer_set_symbols(&inc->scratch, symbols);
+    lexer_intern_tokens(&inc->lexer, 0, inc->lexer.tokens.count);
+}
+
+// the quotes and body of a literal come from one call, the body and the
+// closing quote are the only tokens that do not start a call
+static int is_call_start(Token_buffer *tokens, size_t index) {
+    uint8_t type = tokens->types[index];
+    if (type == TOKEN_STRING_LITERAL || type == TOKEN_CHAR_LITERAL) return 0;
+
+    if ((type == TOKEN_DOUBLE_QUOTE || type == TOKEN_SINGLE_QUOTE) && index > 0) {
+        uint8_t before = tokens->types[index - 1];
+        return before != TOKEN_STRING_LITERAL && before != TOKEN_CHAR_LITERAL;
+    }
+    return 1;
+}
+
+// index of the first diagnostic at or after offset
+static size_t first_diagnostic(Diagnostic_list *list, uint32_t offset) {
+    size_t low = 0, high = list->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (list->items[mid].offset < offset) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// index of the first token starting at or after offset
+static size_t lower_bound(Token_buffer *tokens, size_t low, uint32_t offset) {
+    size_t high = tokens->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (tokens->offsets[mid] < offset) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static int apply_text_edit(Incremental_lexer *inc, size_t offset, size_t removed,
+                           const char *inserted, size_t inserted_length) {
+    size_t length = inc->length - removed + inserted_length;
+
+    if (length > inc->capacity) {
+        size_t capacity = inc->capacity * 2;
+        if (capacity < length) capacity = length;
+
+        char *grown = realloc(inc->text, capacity);
+        if (!grown) return -1;
+
+        inc->text = grown;
+        inc->capacity = capacity;
+    }
+
+    memmove(inc->text + offset + inserted_length, inc->text + offset + removed,
+            inc->length - offset - removed);
+    // a pure deletion may pass no inserted text at all
+    if (inserted_length > 0) {
+        memcpy(inc->text + offset, inserted, inserted_length);
+    }
+    inc->length = length;
+    return 0;
+}
+
+// replace [offset, offset + removed) of the text with inserted. on success
+// the token stream matches a full re-lex of the new text and changed tells
+// which tokens were replaced. returns -1 with errno set to EINVAL if the
+// range is outside the text, nothing is changed then. if memory runs out
+// (ENOMEM) the token stream may be stale and has to be rebuilt
+int incremental_edit(Incremental_lexer *inc, size_t offset, size_t removed,
+                     const char *inserted, size_t inserted_length, Token_edit *changed) {
+    if (offset > inc->length || removed > inc->length - offset) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Lexer *lexer = &inc->lexer;
+    Token_buffer *tokens = &lexer->tokens;
+
+    // the token before the edit may grow into it, re-lexing starts at the
+    // last call start before that whose previous call did not look ahead
+    // into the edit. every token before it is kept as is
+    size_t first = lower_bound(tokens, 0, offset);
+    if (first > 0) first--;
+    while (first > 0 && (!is_call_start(tokens, first) ||
+                         tokens->offsets[first - 1] + tokens->lengths[first - 1] + LEXER_LOOKAHEAD > offset)) {
+        first--;
+    }
+
+    if (apply_text_edit(inc, offset, removed, inserted, inserted_length) < 0) return -1;
+    line_index_edit(&lexer->lines, offset, removed, inserted, inserted_length);
+
+    Lexer *scratch = &inc->scratch;
+    lexer_reset(scratch);
+    lexer_set_source(scratch, inc->text, inc->length);
+    if (first < tokens->count && tokens->offsets[first] < offset) {
+        scratch->position = tokens->offsets[first];
+    }
+    else {
+        first = 0;
+    }
+
+    size_t edit_end = offset + inserted_length;
+    size_t resume = tokens->count;
+    uint32_t sync_offset = UINT32_MAX;
+
+    while (scratch->position < scratch->length) {
+        size_t before = scratch->tokens.count;
+        if (lexer_scan(scratch) == 0) continue;
+
+        uint32_t start = scratch->tokens.offsets[before];
+        if (start < edit_end) continue;
+
+        // the same text follows, look for an old call at the mapped offset
+        uint32_t old_start = start - inserted_length + removed;
+        size_t index = lower_bound(tokens, first, old_start);
+        if (index < tokens->count && tokens->offsets[index] == old_start && is_call_start(tokens, index)) {
+            resume = index;
+            scratch->tokens.count = before;
+            sync_offset = start;
+            break;
+        }
+    }
+
+    // old diagnostics of the replaced tokens go, the ones after them are
+    // shifted like the tokens below and located again
+    Diagnostic_list *diagnostics = &lexer->diagnostics;
+    size_t diagnostics_from = first_diagnostic(diagnostics, first > 0 ? tokens->offsets[first] : 0);
+    size_t diagnostics_to = resume < tokens->count ? first_diagnostic(diagnostics, tokens->offsets[resume])
+                                                   : diagnostics->count;
+
+    // shift the kept tail in place
+    uint32_t offset_shift = (uint32_t)(inserted_length - removed);
+    for (size_t i = diagnostics_to; i < diagnostics->count; i++) {
+        diagnostics->items[i].offset += offset_shift;
+    }
+
+    for (size_t i = resume; i < tokens->count; i++) {
+        tokens->offsets[i] += offset_shift;
+    }
+
+    if (token_buffer_splice(tokens, first, resume - first, &scratch->tokens) < 0) return -1;
+
+    // the call synced on was re-lexed too, its diagnostic is already kept
+    size_t inserted_diagnostics = first_diagnostic(&scratch->diagnostics, sync_offset);
+    if (diagnostic_list_splice(diagnostics, diagnostics_from, diagnostics_to - diagnostics_from,
+                               scratch->diagnostics.items, inserted_diagnostics) < 0) {
+        return -1;
+    }
+
+    lexer->source = inc->text;
+    lexer->length = inc->length;
+    lexer->position = inc->length;
+    if (lexer->located > diagnostics_from) lexer->located = diagnostics_from;
+    lexer_locate_diagnostics(lexer);
+
+    if (changed) {
+        changed->first = first;
+        changed->removed = resume - first;
+        changed->inserted = scratch->tokens.count;
+    }
+    return 0;
+}
+
+void incremental_cleanup(Incremental_lexer *inc) {
+    lexer_cleanup(&inc->lexer);
+    lexer_cleanup(&inc->scratch);
+    free(inc->text);
+    inc->text = NULL;
+    inc->length = inc->capacity = 0;
+}
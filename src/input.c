@@ -0,0 +1,187 @@
+#include "input.h"
+#include "stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define READ_CHUNK_LEN (64 * 1024)
+
+// used for anything that cant be mapped, grows the buffer geometrically
+// so a pipe costs a handful of read calls instead of one per line
+static int read_all(int fd, Source_file *file) {
+    size_t capacity = READ_CHUNK_LEN;
+    size_t length = 0;
+    char *data = malloc(capacity);
+    if (!data) return -1;
+    STATS_ALLOC(capacity);
+
+    while (1) {
+        if (length == capacity) {
+            capacity *= 2;
+            char *grown = realloc(data, capacity);
+            if (!grown) {
+                free(data);
+                return -1;
+            }
+            data = grown;
+            STATS_ALLOC(capacity);
+        }
+
+        ssize_t n = read(fd, data + length, capacity - length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            free(data);
+            return -1;
+        }
+        if (n == 0) break;
+
+        length += n;
+    }
+
+    file->data = data;
+    file->length = length;
+    file->mapped = 0;
+    return 0;
+}
+
+// a mapped file is read by page faults while it is lexed, so for those
+// the io phase only covers open and mmap
+int source_file_open(const char *path, Source_file *file) {
+    STATS_BEGIN(timer);
+    file->data = NULL;
+    file->length = 0;
+    file->mapped = 0;
+
+    // "-" means stdin
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        if (fd != STDIN_FILENO) close(fd);
+        return -1;
+    }
+
+    int result = 0;
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            file->data = data;
+            file->length = st.st_size;
+            file->mapped = 1;
+        }
+        else {
+            result = read_all(fd, file);
+        }
+    }
+    else if (!S_ISREG(st.st_mode)) {
+        result = read_all(fd, file);
+    }
+
+    if (fd != STDIN_FILENO) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+    }
+
+    STATS_END(timer, STAT_IO);
+    STATS_BYTES(file->length);
+    return result;
+}
+
+void source_file_close(Source_file *file) {
+    if (!file->data) return;
+
+    if (file->mapped) {
+        munmap((void *)file->data, file->length);
+    }
+    else {
+        free((void *)file->data);
+    }
+
+    file->data = NULL;
+    file->length = 0;
+}
+
+int source_stream_open(const char *path, size_t block_size, Source_stream *stream) {
+    if (block_size < STREAM_BLOCK_MIN) block_size = STREAM_BLOCK_MIN;
+
+    stream->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (stream->fd < 0) return -1;
+
+    stream->length = 0;
+    stream->block_size = block_size;
+    stream->capacity = 2 * block_size;
+    stream->data = malloc(stream->capacity);
+    if (!stream->data) {
+        if (stream->fd != STDIN_FILENO) close(stream->fd);
+        return -1;
+    }
+    STATS_ALLOC(stream->capacity);
+
+    posix_fadvise(stream->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return 0;
+}
+
+// the bytes the lexer has not consumed yet (a partial line) move to the
+// front of the buffer and up to one block is read after them. the buffer
+// only grows when a single line is longer than a block
+size_t source_stream_refill(void *context, size_t consumed, const char **window) {
+    Source_stream *stream = context;
+
+    size_t kept = stream->length - consumed;
+    if (consumed > 0 && kept > 0) {
+        memmove(stream->data, stream->data + consumed, kept);
+    }
+    stream->length = kept;
+
+    if (stream->capacity - kept < stream->block_size) {
+        size_t capacity = stream->capacity * 2;
+        char *grown = realloc(stream->data, capacity);
+        if (!grown) {
+            perror("source_stream_refill");
+            exit(EXIT_FAILURE);
+        }
+        stream->data = grown;
+        stream->capacity = capacity;
+        STATS_ALLOC(capacity);
+    }
+
+    // a pipe may return less than a block, that is enough since the lexer
+    // asks again until it has a whole line
+    STATS_BEGIN(timer);
+    ssize_t n;
+    do {
+        n = read(stream->fd, stream->data + kept, stream->block_size);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        perror("source_stream_refill");
+        exit(EXIT_FAILURE);
+    }
+
+    STATS_END(timer, STAT_IO);
+    STATS_BYTES(n);
+
+    stream->length += n;
+    *window = stream->data;
+    return stream->length;
+}
+
+void source_stream_close(Source_stream *stream) {
+    if (stream->fd >= 0 && stream->fd != STDIN_FILENO) {
+        close(stream->fd);
+    }
+    free(stream->data);
+
+    stream->fd = -1;
+    stream->data = NULL;
+    stream->length = 0;
+}
@@ -0,0 +1,250 @@
+#include "intern.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_MIN_SLOTS 64
+#define INTERN_MAX_SYMBOLS ((uint32_t)INTERN_MAX_BLOCKS * INTERN_BLOCK_SIZE)
+
+static inline uint64_t read32(const char *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof value);
+    return value;
+}
+
+// murmur3 finalizer over 8 bytes at a time, identifiers are short so the
+// tail is most of the work. it is read with two overlapping loads instead
+// of a byte loop
+static uint64_t intern_hash(const char *text, size_t length) {
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ length;
+
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, text, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+        text += 8;
+        length -= 8;
+    }
+
+    uint64_t tail = 0;
+    if (length >= 4) {
+        tail = (read32(text) << 32) | read32(text + length - 4);
+    }
+    else if (length > 0) {
+        const unsigned char *bytes = (const unsigned char *)text;
+        tail = ((uint64_t)bytes[0] << 16) | ((uint64_t)bytes[length >> 1] << 8) | bytes[length - 1];
+    }
+    hash ^= tail;
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static inline uint64_t slot_tag(uint64_t hash) { return hash & 0xffffffff00000000ull; }
+
+static inline size_t slot_start(uint64_t hash, size_t mask) { return (hash >> INTERN_SHARD_BITS) & mask; }
+
+static inline Intern_symbol *symbol_at(Intern_table *table, uint32_t id) {
+    Intern_symbol *block = __atomic_load_n(&table->blocks[id >> INTERN_BLOCK_BITS], __ATOMIC_ACQUIRE);
+    return &block[id & (INTERN_BLOCK_SIZE - 1)];
+}
+
+static Intern_slots *slots_create(size_t capacity) {
+    Intern_slots *slots = calloc(1, sizeof(Intern_slots) + capacity * sizeof(uint64_t));
+    if (!slots) return NULL;
+    STATS_ALLOC(sizeof(Intern_slots) + capacity * sizeof(uint64_t));
+
+    slots->mask = capacity - 1;
+    return slots;
+}
+
+int intern_table_initialize(Intern_table *table) {
+    table->blocks = calloc(INTERN_MAX_BLOCKS, sizeof(Intern_symbol *));
+    if (!table->blocks) return -1;
+
+    for (int i = 0; i < INTERN_SHARDS; i++) {
+        Intern_shard *shard = &table->shards[i];
+        shard->slots = slots_create(INTERN_MIN_SLOTS);
+        if (!shard->slots) {
+            while (i-- > 0) free(table->shards[i].slots);
+            free(table->blocks);
+            return -1;
+        }
+
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->count = 0;
+        arena_initialize(&shard->arena);
+    }
+
+    pthread_mutex_init(&table->block_lock, NULL);
+    table->count = 0;
+    return 0;
+}
+
+// safe without the shard lock, the slots array is never written after it
+// is replaced and a slot is only published once its symbol is complete
+static uint32_t slots_find(Intern_table *table, Intern_slots *slots, uint64_t hash, const char *text,
+                           size_t length) {
+    uint64_t tag = slot_tag(hash);
+
+    for (size_t i = slot_start(hash, slots->mask);; i = (i + 1) & slots->mask) {
+        uint64_t slot = __atomic_load_n(&slots->slots[i], __ATOMIC_ACQUIRE);
+        if (slot == 0) return INTERN_NONE;
+        if (slot_tag(slot) != tag) continue;
+
+        uint32_t id = (uint32_t)slot - 1;
+        Intern_symbol *symbol = symbol_at(table, id);
+        if (symbol->length == length && memcmp(symbol->text, text, length) == 0) return id;
+    }
+}
+
+static void slots_put(Intern_slots *slots, uint64_t hash, uint32_t id) {
+    size_t i = slot_start(hash, slots->mask);
+    while (slots->slots[i] != 0) i = (i + 1) & slots->mask;
+
+    __atomic_store_n(&slots->slots[i], slot_tag(hash) | (id + 1), __ATOMIC_RELEASE);
+}
+
+// doubles the shard's slots. the old array is kept for lookups that are
+// still on it, a miss there is looked up again, see intern_find
+static void shard_grow(Intern_table *table, Intern_shard *shard) {
+    Intern_slots *old = shard->slots;
+    Intern_slots *grown = slots_create((old->mask + 1) * 2);
+    if (!grown) {
+        perror("intern");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i <= old->mask; i++) {
+        if (old->slots[i] == 0) continue;
+
+        uint32_t id = (uint32_t)old->slots[i] - 1;
+        slots_put(grown, symbol_at(table, id)->hash, id);
+    }
+
+    grown->retired = old;
+    __atomic_store_n(&shard->slots, grown, __ATOMIC_RELEASE);
+}
+
+static Intern_symbol *symbol_create(Intern_table *table, uint32_t id) {
+    Intern_symbol **block = &table->blocks[id >> INTERN_BLOCK_BITS];
+    if (!__atomic_load_n(block, __ATOMIC_ACQUIRE)) {
+        // ids are handed out across shards, two of them may want the same block
+        pthread_mutex_lock(&table->block_lock);
+        if (!*block) {
+            Intern_symbol *fresh = malloc(sizeof(Intern_symbol) * INTERN_BLOCK_SIZE);
+            if (!fresh) {
+                perror("intern");
+                exit(EXIT_FAILURE);
+            }
+            STATS_ALLOC(sizeof(Intern_symbol) * INTERN_BLOCK_SIZE);
+            __atomic_store_n(block, fresh, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&table->block_lock);
+    }
+
+    return symbol_at(table, id);
+}
+
+// the id of the spelling, added to the table if it is new
+uint32_t intern(Intern_table *table, const char *text, size_t length) {
+    uint64_t hash = intern_hash(text, length);
+    Intern_shard *shard = &table->shards[hash & (INTERN_SHARDS - 1)];
+
+    uint32_t id = slots_find(table, __atomic_load_n(&shard->slots, __ATOMIC_ACQUIRE), hash, text, length);
+    if (id != INTERN_NONE) return id;
+
+    pthread_mutex_lock(&shard->lock);
+
+    // another thread may have added it since
+    id = slots_find(table, shard->slots, hash, text, length);
+    if (id != INTERN_NONE) {
+        pthread_mutex_unlock(&shard->lock);
+        return id;
+    }
+
+    // at most half full
+    if ((shard->count + 1) * 2 > shard->slots->mask + 1) {
+        shard_grow(table, shard);
+    }
+
+    id = __atomic_fetch_add(&table->count, 1, __ATOMIC_RELAXED);
+    if (id >= INTERN_MAX_SYMBOLS) {
+        fprintf(stderr, "intern: more than %u distinct identifiers\n", INTERN_MAX_SYMBOLS);
+        exit(EXIT_FAILURE);
+    }
+
+    char *copy = arena_alloc(&shard->arena, length + 1);
+    if (!copy) {
+        perror("intern");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+
+    Intern_symbol *symbol = symbol_create(table, id);
+    symbol->text = copy;
+    symbol->length = length;
+    symbol->hash = hash;
+
+    slots_put(shard->slots, hash, id);
+    shard->count++;
+
+    pthread_mutex_unlock(&shard->lock);
+    return id;
+}
+
+// the id of the spelling or INTERN_NONE, never adds to the table
+uint32_t intern_find(Intern_table *table, const char *text, size_t length) {
+    uint64_t hash = intern_hash(text, length);
+    Intern_shard *shard = &table->shards[hash & (INTERN_SHARDS - 1)];
+    Intern_slots *slots = __atomic_load_n(&shard->slots, __ATOMIC_ACQUIRE);
+
+    for (;;) {
+        uint32_t id = slots_find(table, slots, hash, text, length);
+
+        // a miss only counts on the current array, one that was just
+        // replaced lacks the symbols added after that
+        Intern_slots *current = __atomic_load_n(&shard->slots, __ATOMIC_ACQUIRE);
+        if (id != INTERN_NONE || current == slots) return id;
+        slots = current;
+    }
+}
+
+// the spelling of an id returned by intern, valid until intern_table_free
+const char *intern_text(Intern_table *table, uint32_t id, size_t *length) {
+    Intern_symbol *symbol = symbol_at(table, id);
+    if (length) *length = symbol->length;
+    return symbol->text;
+}
+
+size_t intern_count(Intern_table *table) { return __atomic_load_n(&table->count, __ATOMIC_ACQUIRE); }
+
+void intern_table_free(Intern_table *table) {
+    for (int i = 0; i < INTERN_SHARDS; i++) {
+        Intern_shard *shard = &table->shards[i];
+
+        Intern_slots *slots = shard->slots;
+        while (slots) {
+            Intern_slots *retired = slots->retired;
+            free(slots);
+            slots = retired;
+        }
+
+        arena_free(&shard->arena);
+        pthread_mutex_destroy(&shard->lock);
+    }
+
+    for (size_t i = 0; i < INTERN_MAX_BLOCKS && table->blocks[i]; i++) {
+        free(table->blocks[i]);
+    }
+    free(table->blocks);
+    pthread_mutex_destroy(&table->block_lock);
+}
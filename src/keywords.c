@@ -0,0 +1,89 @@
+#include "keywords.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char *keywords[] = {
+    // c constructs
+    "if", 
+    "else",
+    "for",
+    "while",
+    "do",
+    "return",
+    "include",
+    "static",
+    "extern",
+    "typedef",
+    "unsigned",
+    "signed",
+    "switch",
+    "enum",
+    "break",
+    "case",
+    "const",
+    "continue",
+    "sizeof",
+    // datatypes
+    "struct",
+    "int",
+    "char",
+    "void",
+    "long",
+    "double",
+    "float",
+    "short",
+    "union", 
+    NULL
+};
+
+// perfect hash over the fixed keyword set: first char, last char and length
+// pick a unique slot, so a word needs one probe and at most one memcmp.
+// the multipliers were found by brute force over keywords[] above, if a
+// keyword is added and collides keyword_table_initialize aborts and they
+// have to be searched again
+#define KEYWORD_TABLE_SIZE 64
+#define KEYWORD_MIN_LEN 2
+#define KEYWORD_MAX_LEN 8
+
+typedef struct {
+    const char *word;
+    size_t length;
+} Keyword_slot;
+
+static Keyword_slot keyword_table[KEYWORD_TABLE_SIZE];
+static pthread_once_t keyword_table_once = PTHREAD_ONCE_INIT;
+
+static inline size_t keyword_hash(const char *word, size_t length) {
+    return ((unsigned char)word[0] * 9 + (unsigned char)word[length - 1] * 6 + length) &
+           (KEYWORD_TABLE_SIZE - 1);
+}
+
+static void keyword_table_build(void) {
+    for (const char **current = keywords; *current != NULL; current++) {
+        size_t length = strlen(*current);
+        Keyword_slot *slot = &keyword_table[keyword_hash(*current, length)];
+
+        if (slot->word != NULL || length < KEYWORD_MIN_LEN || length > KEYWORD_MAX_LEN) {
+            fprintf(stderr, "keyword table is not perfect for '%s'\n", *current);
+            abort();
+        }
+
+        slot->word = *current;
+        slot->length = length;
+    }
+}
+
+// fills a static table, nothing is allocated. safe to call from any thread
+void keyword_table_initialize(void) {
+    pthread_once(&keyword_table_once, keyword_table_build);
+}
+
+int is_keyword(const char *word, size_t length) {
+    if (length < KEYWORD_MIN_LEN || length > KEYWORD_MAX_LEN) return 0;
+
+    Keyword_slot *slot = &keyword_table[keyword_hash(word, length)];
+    return slot->length == length && memcmp(slot->word, word, length) == 0;
+}
@@ -1,599 +1,631 @@
 #include "lexer.h"
-#include "hash_map.h"
+#include "char_class.h"
+#include "keywords.h"
+#include "operators.h"
+#include "simd.h"
+#include "stats.h"
 
-#include <ctype.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// define global keyword map instead of passing it to every lexer function
-Hash_map keyword_map;
-
-char *keywords[] = {
-    // c constructs
-    "if", 
-    "else",
-    "for",
-    "while",
-    "do",
-    "return",
-    "include",
-    "static",
-    "extern",
-    "typedef",
-    "unsigned",
-    "signed",
-    "switch",
-    "enum",
-    "break",
-    "case",
-    "const",
-    "continue"
-    "sizeof"
-    // datatypes
-    "struct",
-    "int",
-    "char",
-    "void",
-    "long",
-    "double",
-    "float",
-    "short",
-    "union", 
-    NULL
+// what the scanner does with the first byte of a token
+typedef enum {
+    STATE_INVALID,
+    STATE_END,
+    STATE_NEWLINE,
+    STATE_IDENTIFIER,
+    STATE_NUMBER,
+    STATE_PUNCTUATION,
+    STATE_SLASH,
+    STATE_STRING,
+    STATE_CHAR,
+} Scan_state;
+
+static const uint8_t start_state[256] = {
+    ['\0'] = STATE_END,
+    ['\n'] = STATE_NEWLINE,
+    ['A' ... 'Z'] = STATE_IDENTIFIER,
+    ['a' ... 'z'] = STATE_IDENTIFIER,
+    ['_'] = STATE_IDENTIFIER,
+    ['0' ... '9'] = STATE_NUMBER,
+    ['/'] = STATE_SLASH,
+    ['"'] = STATE_STRING,
+    ['\''] = STATE_CHAR,
+    ['{'] = STATE_PUNCTUATION, ['}'] = STATE_PUNCTUATION,
+    ['('] = STATE_PUNCTUATION, [')'] = STATE_PUNCTUATION,
+    [';'] = STATE_PUNCTUATION, [','] = STATE_PUNCTUATION,
+    ['.'] = STATE_PUNCTUATION, ['+'] = STATE_PUNCTUATION,
+    ['-'] = STATE_PUNCTUATION, ['='] = STATE_PUNCTUATION,
+    [':'] = STATE_PUNCTUATION, ['*'] = STATE_PUNCTUATION,
+    ['|'] = STATE_PUNCTUATION, ['&'] = STATE_PUNCTUATION,
+    ['!'] = STATE_PUNCTUATION, ['#'] = STATE_PUNCTUATION,
+    ['<'] = STATE_PUNCTUATION, ['>'] = STATE_PUNCTUATION,
+    ['['] = STATE_PUNCTUATION, [']'] = STATE_PUNCTUATION,
+    ['?'] = STATE_PUNCTUATION, ['%'] = STATE_PUNCTUATION,
+    ['^'] = STATE_PUNCTUATION, ['~'] = STATE_PUNCTUATION,
 };
 
-
 static char lexer_advance(Lexer *lexer) {
-    lexer->col++;
     return lexer->source[lexer->position++];
 }
 
-char lexer_peek(Lexer *lexer) { return lexer->source[lexer->position]; }
+char lexer_peek(Lexer *lexer) {
+    if (lexer->position >= lexer->length) return '\0';
+    return lexer->source[lexer->position];
+}
 
-void lexer_initialize(Lexer *lexer) {
-    // init the keyword map as well
-    hash_map_initialize(&keyword_map);
+static int lexer_at_end(Lexer *lexer) { return lexer->position >= lexer->length; }
 
-    lexer->line = 1;
-    lexer->col = 1;
-    lexer->position = 0;
-    lexer->head = NULL;
-}
+// consume the run of bytes in the given class
+static size_t skip_class(Lexer *lexer, uint16_t mask) {
+    const char *source = lexer->source;
+    size_t position = lexer->position;
+    size_t length = lexer->length;
 
-int is_seperator(char ch) {
-    return (ch == '{' || ch == '}' || ch == '(' || ch == ')' || ch == ',' ||
-            ch == ';' || ch == '\n' || ch == '\r');
-}
+    while (position < length && char_is(source[position], mask)) {
+        position++;
+    }
 
-int is_terminating(char ch){
-    return (ch == EOF || ch == '\0');
+    size_t skipped = position - lexer->position;
+    lexer->position = position;
+    return skipped;
 }
 
-size_t get_token_length(Token *token) {
-    if (!token) return 0;
-
-    int result = 0;
-    result += strlen(get_token_name(token->type));
-    result += strlen(token->value);
-    
-    // to count digits in line number 
-    int l = token->line;
-    int l_count = 0;
-    while (l)
-    {
-        l_count++;
-        l = l / 10;
+// same as skip_class for the classes that have a vector kernel. most runs
+// are short, so the first few bytes are checked here and the kernel is
+// only called once a run is long enough to pay for it
+#define SKIP_RUN_SCALAR 8
 
-    }
-    // to count digits in col number 
-    int c = token->col;
-    int c_count = 0;
-    while (c)
-    {
-        c_count++;
-        c = c / 10;
+static inline size_t skip_run(Lexer *lexer, uint16_t mask, Simd_run_fn run) {
+    const char *source = lexer->source;
+    size_t position = lexer->position;
+    size_t limit = lexer->length - position < SKIP_RUN_SCALAR ? lexer->length : position + SKIP_RUN_SCALAR;
+
+    while (position < limit && char_is(source[position], mask)) {
+        position++;
     }
 
-    result += (l_count + c_count);
+    if (position == limit && position < lexer->length) {
+        position += run(source + position, lexer->length - position);
+    }
 
-    // for extra characters like spaces and , and 5 for Ln and Col
-    result += 14;
-    return result;
+    size_t skipped = position - lexer->position;
+    lexer->position = position;
+    return skipped;
 }
 
-void print_tokens(Lexer *lexer) {
-    Token *current = lexer->head;
+// for a streaming lexer the text is only there while the token is in the
+// window, that is until the next lexer_next call
+const char *token_text(Lexer *lexer, const Token *token) { return lexer->source + (token->offset - lexer->base); }
+
+Token token_at(Lexer *lexer, size_t index) {
+    Token_buffer *tokens = &lexer->tokens;
+    Token token = {
+        .offset = tokens->offsets[index],
+        .length = tokens->lengths[index],
+        .type = tokens->types[index],
+        .payload = tokens->payloads[index],
+        .value = tokens->values[index],
+    };
+    return token;
+}
 
-    int first_break_point = 50;
-    int second_break_point = 100;
-    
-    int chars_printed = 0;
-    while (current) {
-        int total_len = get_token_length(current);
+void token_iter_initialize(Token_iter *iter, Lexer *lexer) {
+    iter->lexer = lexer;
+    iter->index = 0;
+}
 
-        if (total_len < first_break_point) {
-            int padding_len = first_break_point - total_len;
-            chars_printed += first_break_point;
+int token_iter_next(Token_iter *iter, Token *token) {
+    if (iter->index >= iter->lexer->tokens.count) return 0;
 
-            printf("%s \x1B[34m'%s'", get_token_name(current->type), current->value);
-            printf("\x1B[37m Ln %lu, Col %lu", current->line, current->col);
-            printf("%-*s", padding_len, "");
-        }
-        else if(total_len >= first_break_point && total_len <= second_break_point) {
-            int padding_len = second_break_point - total_len;
-            chars_printed += second_break_point;
+    *token = token_at(iter->lexer, iter->index++);
+    return 1;
+}
 
-            printf("%s \x1B[34m'%s'", get_token_name(current->type), current->value);
-            printf("\x1B[37m Ln %lu, Col %lu", current->line, current->col);
-            printf("%-*s", padding_len, "");
-        }
-        else {
-            if (chars_printed > 0) {
-                printf("\n%s \x1B[34m'%s'", get_token_name(current->type), current->value);
-                printf("\x1B[37m Ln %lu, Col %lu\n", current->line, current->col);
-            }
-            else {
-                printf("%s \x1B[34m'%s'", get_token_name(current->type), current->value);
-                printf("\x1B[37m Ln %lu, Col %lu", current->line, current->col);
-            }
+void lexer_initialize(Lexer *lexer) {
+    // fill the keyword table on first use
+    keyword_table_initialize();
+    operator_table_initialize();
+    simd_initialize();
 
-            chars_printed = 0;
-        }
-        
-        if (chars_printed > second_break_point) {
-            chars_printed = 0;
-            printf("\n");
-        }
+    lexer->position = 0;
+    lexer->source = NULL;
+    lexer->length = 0;
+    lexer->base = 0;
+    lexer->refill = NULL;
+    lexer->refill_context = NULL;
+    lexer->input_done = 1;
+    lexer->line_end = 0;
+    lexer->in_comment = 0;
+    lexer->symbols = NULL;
+    lexer->next_token = 0;
+    lexer->located = 0;
+    token_buffer_initialize(&lexer->tokens);
+    diagnostic_list_initialize(&lexer->diagnostics);
+    line_index_initialize(&lexer->lines);
+}
 
-        current = current->next;
-    }
+void lexer_set_source(Lexer *lexer, const char *source, size_t length) {
+    lexer->source = source;
+    lexer->length = length;
+    lexer->position = 0;
+    lexer->base = 0;
+    lexer->refill = NULL;
+    lexer->input_done = 1;
+    lexer->in_comment = 0;
+    line_index_clear(&lexer->lines);
+}
 
-    if (fgetc(stdout) != '\n')
-    {
-        printf("\n");
-    }
-    
+// stream the input instead of handing it over whole. the window starts
+// empty and is filled by refill as lexer_next needs it, so only the
+// window and the tokens of one lexer_scan call are held at a time
+void lexer_set_refill(Lexer *lexer, Lexer_refill_fn refill, void *context) {
+    lexer->source = NULL;
+    lexer->length = 0;
+    lexer->position = 0;
+    lexer->base = 0;
+    lexer->refill = refill;
+    lexer->refill_context = context;
+    lexer->input_done = 0;
+    lexer->line_end = 0;
+    lexer->in_comment = 0;
+    line_index_clear(&lexer->lines);
 }
 
-void lexer_cleanup(Lexer *lexer) {
-    if (!lexer->head) {
-        return;
-    }
+// identifiers get their symbol id in symbols as payload from now on, it
+// is kept across lexer_reset
+void lexer_set_symbols(Lexer *lexer, Intern_table *symbols) { lexer->symbols = symbols; }
 
-    Token *slow = lexer->head;
-    Token *fast = lexer->head->next;
+// interns the identifiers of tokens [from, to) that were not scanned by
+// this lexer, loaded from a token file or copied from other lexers
+void lexer_intern_tokens(Lexer *lexer, size_t from, size_t to) {
+    if (!lexer->symbols) return;
 
-    while (slow) {
-        free(slow);
-        slow = fast;
+    Token_buffer *tokens = &lexer->tokens;
+    for (size_t i = from; i < to; i++) {
+        if (tokens->types[i] != TOKEN_IDENTIFIER) continue;
 
-        if (fast) {
-            fast = fast->next;
-        }
+        const char *text = lexer->source + (tokens->offsets[i] - lexer->base);
+        tokens->payloads[i] = intern(lexer->symbols, text, tokens->lengths[i]);
     }
-
-    lexer->head = NULL;
-
-    // free keyword map as well
-    map_free(&keyword_map);
 }
 
-Token *create_token(Lexer *lexer, TokenType type, char *value) {
-    static Token *current_token = NULL;
-    Token *ptr = (Token *)malloc(sizeof(Token));
+// decodes the number literals of tokens [from, to) again, for tokens that
+// were not scanned from the source, like a loaded token file
+void lexer_decode_numbers(Lexer *lexer, size_t from, size_t to) {
+    Token_buffer *tokens = &lexer->tokens;
+    for (size_t i = from; i < to; i++) {
+        if (tokens->types[i] != TOKEN_NUMBER_LITERAL) continue;
+
+        Number number;
+        number_scan(lexer->source + (tokens->offsets[i] - lexer->base), tokens->lengths[i], &number);
+        tokens->payloads[i] = number.flags;
+        tokens->values[i] = number.value;
+    }
+}
 
-    ptr->line = lexer->line;
-    
-    // this is because scanning these tokens advances lexer position therefore its
-    // column position
-    switch (type)
-    {
-    case TOKEN_IDENTIFIER:
-    case TOKEN_STRING_LITERAL:
-    case TOKEN_CHAR_LITERAL:
-    case TOKEN_NUMBER_LITERAL:
-    case TOKEN_KEYWORD:
-        ptr->col = lexer->col - strlen(value);
-        break;
-    
-    default:
-        ptr->col = lexer->col;
-        break;
+// line and col of a source offset. the line index is extended on
+// demand: a whole source is indexed to its end on the first call, a
+// stream up to the end of its window. offsets of a stream must be in the
+// window or on a line that reaches into it
+Source_position lexer_position(Lexer *lexer, uint32_t offset) {
+    Line_index *lines = &lexer->lines;
+    size_t end = lexer->base + lexer->length;
+
+    if (lines->scanned < offset && lines->scanned < end) {
+        STATS_BEGIN(timer);
+        line_index_scan(lines, lexer->source + (lines->scanned - lexer->base), end - lines->scanned);
+        STATS_END(timer, STAT_LINES);
     }
+    return line_index_find(lines, offset);
+}
 
-    ptr->type = type;
-    ptr->next = NULL;
-    strncpy(ptr->value, value, MAX_ID_LEN);
+// fills line and col of the diagnostics pushed since the last call
+void lexer_locate_diagnostics(Lexer *lexer) {
+    Diagnostic_list *list = &lexer->diagnostics;
 
-    if (lexer->head == NULL) {
-        lexer->head = ptr;
-        current_token = ptr;
-    } else {
-        current_token->next = ptr;
-        current_token = ptr;
+    for (; lexer->located < list->count; lexer->located++) {
+        Diagnostic *diagnostic = &list->items[lexer->located];
+        Source_position position = lexer_position(lexer, diagnostic->offset);
+        diagnostic->line = position.line;
+        diagnostic->col = position.col;
     }
-    
-    return ptr;
 }
 
-Token *scan_alphabets(Lexer *lexer) {
-    char token_value[MAX_ID_LEN];
-    memset(token_value, '\0', MAX_ID_LEN);
+// the rest of a block comment up to and including its "*/". a streamed
+// comment that goes past the window is consumed up to the window end and
+// lexer_next continues it once more input is in. an unterminated comment
+// only gets a diagnostic at its "/*", there is no token left to replace
+// since it takes the rest of the input with it
+static void skip_block_comment(Lexer *lexer) {
+    const char *data = lexer->source + lexer->position;
+    size_t rest = lexer->length - lexer->position;
+    size_t end = simd.block_comment(data, rest);
+    int closed = end >= 2 && data[end - 2] == '*' && data[end - 1] == '/';
+    int continued = lexer->in_comment;
+
+    if (!closed && lexer->refill && !lexer->input_done) {
+        // the '/' may come with the next block
+        if (end > 0 && data[end - 1] == '*') end--;
+
+        // the line of the "/*" leaves the line index with the window
+        if (!continued) {
+            lexer->comment_position = lexer_position(lexer, lexer->comment_offset);
+        }
 
-    size_t start = lexer->position;
-    while (isalpha(lexer_peek(lexer)) || lexer_peek(lexer) == '_' || isdigit(lexer_peek(lexer))) {
-        lexer_advance(lexer);
+        lexer->position += end;
+        lexer->in_comment = 1;
+        return;
     }
 
-    if (lexer->position - start > MAX_ID_LEN - 1) {
-        printf("error at line %lu at position %lu\n", lexer->line,
-               lexer->position);
-        printf("identifier length exceeds MAX_ID_LEN: %d\n", MAX_ID_LEN);
-        exit(EXIT_FAILURE);
-    }
+    lexer->position += end;
+    lexer->in_comment = 0;
 
-    strncpy(token_value, &lexer->source[start], lexer->position - start);
+    if (!closed) {
+        Diagnostic *diagnostic = diagnostic_list_push(&lexer->diagnostics);
+        diagnostic->offset = lexer->comment_offset;
+        diagnostic->code = DIAGNOSTIC_UNTERMINATED_COMMENT;
+        snprintf(diagnostic->message, sizeof diagnostic->message, "unterminated /* comment");
 
-    if (map_has(&keyword_map, token_value) == 1)
-    {
-        return create_token(lexer, TOKEN_KEYWORD, token_value);
+        // the ones before it were located when the window moved on
+        if (continued) {
+            diagnostic->line = lexer->comment_position.line;
+            diagnostic->col = lexer->comment_position.col;
+            lexer->located = lexer->diagnostics.count;
+        }
     }
-    
-    return create_token(lexer, TOKEN_IDENTIFIER, token_value);
 }
 
-Token *scan_numbers(Lexer *lexer) {
-    char token_value[MAX_ID_LEN];
-    memset(token_value, '\0', MAX_ID_LEN);
-
-    size_t start = lexer->position;
-    while (isalnum(lexer_peek(lexer)) || lexer_peek(lexer) == '.') {
-        lexer_advance(lexer);
-    }
+static void scan_block_comment(Lexer *lexer) {
+    lexer->comment_offset = lexer->base + lexer->position;
+    lexer->position += 2;
+    skip_block_comment(lexer);
+}
 
-    if (lexer->position - start > MAX_ID_LEN - 1) {
-        printf("error at line %lu at position %lu\n", lexer->line,
-               lexer->position);
-        printf("identifier length exceeds MAX_ID_LEN: %d\n", MAX_ID_LEN);
-        exit(EXIT_FAILURE);
-    }
+static void lexer_refill(Lexer *lexer) {
+    size_t consumed = lexer->position;
+    size_t kept = lexer->length - consumed;
+    const char *window = lexer->source;
 
-    strncpy(token_value, &lexer->source[start], lexer->position - start);
-    Token *token = create_token(lexer, TOKEN_NUMBER_LITERAL , token_value);
-
-    // validate hex, binary and octal literals 
-    if (strstr(token_value, ".") == NULL && token_value[0] == '0' && strlen(token_value) >= 2) {
-           
-        if (strlen(token_value) == 2 && isalpha(token_value[1])) {
-            fprintf(stderr, 
-                    "Invalid suffix '%c' in number literal on line %lu, col %lu\n", 
-                    token_value[1], token->line, token->col);
-            exit(EXIT_FAILURE);
-        }
-        
-        // for hex check if all characters are 0-9, a-f from the third character
-        // for binary 0 or 1
-        // for octal 0-7
-        switch (token_value[1])
-        {
-        case 'x':
-        case 'X':
-            for (size_t i = 2; i < strlen(token_value); i++) {
-                if (!isdigit(token_value[i]) && (tolower(token_value[i]) < 97 || tolower(token_value[i]) > 102)) {
-                    fprintf(stderr, 
-                        "Invalid character '%c' in hex literal on line %lu, col %lu\n", 
-                        token_value[i], token->line, token->col);
-                    exit(EXIT_FAILURE);
-                }
-            }
-            
-            break;
+    // the lines of the consumed bytes go with them, what was not located
+    // yet has to be now
+    lexer_locate_diagnostics(lexer);
+    lexer_position(lexer, lexer->base + consumed);
+    line_index_drop(&lexer->lines, lexer->base + consumed);
 
-        case 'b':
-        case 'B':
-            for (size_t i = 2; i < strlen(token_value); i++) {
-                if (token_value[i] != '0' && token_value[i] != '1') {
-                    fprintf(stderr, 
-                        "Invalid character '%c' in binary literal on line %lu, col %lu\n", 
-                        token_value[i], token->line, token->col);
-                    exit(EXIT_FAILURE);
-                }
-            }
+    size_t length = lexer->refill(lexer->refill_context, consumed, &window);
 
-            break;
-        
-        default:
-            for (size_t i = 1; i < strlen(token_value); i++) {
-                if (token_value[i] < 48 || token_value[i] > 55) {
-                    fprintf(stderr, 
-                        "Invalid character '%c' in octal literal on line %lu, col %lu\n", 
-                        token_value[i], token->line, token->col);
-                    exit(EXIT_FAILURE);
-                }
-            }
-            break;
-        }
+    lexer->base += consumed;
+    lexer->position = 0;
+    lexer->source = window;
+    lexer->length = length;
+    lexer->line_end = length;
+    if (length <= kept) {
+        lexer->input_done = 1;
     }
-    else {
+}
 
-        // scan from the end of string for alphabets
-        int suffix_start_index = strlen(token_value) - 1;
-        while (suffix_start_index > -1 && isalpha(token_value[suffix_start_index])) {
-            suffix_start_index--;
-        }
-        suffix_start_index++;
-
-        // then loop until the first suffix character and check if 
-        // any alphabets appear before it and report an error
-        for (int i = 0; i < suffix_start_index; i++) {
-            if (isalpha(token_value[i]))
-            {
-                fprintf(stderr, 
-                    "Invalid character '%c' in number literal on line %lu, col %lu\n", 
-                    token_value[i], token->line, token->col);
-                exit(EXIT_FAILURE);
+// no token spans a newline, so once the rest of the current line is in
+// the window a lexer_scan call can not run into the end of the window.
+// block comments do span lines, they are continued by lexer_next
+static void lexer_fill_line(Lexer *lexer) {
+    if (lexer->line_end >= lexer->position && lexer->line_end < lexer->length) return;
+
+    size_t search = lexer->position;
+    while (!lexer->input_done) {
+        if (search < lexer->length) {
+            const char *newline = memchr(lexer->source + search, '\n', lexer->length - search);
+            if (newline != NULL) {
+                lexer->line_end = newline - lexer->source;
+                return;
             }
         }
 
-        if (suffix_start_index < (int)strlen(token_value))
-        {
-            char *valid_suffix[] = { "f","u","l","ul","ll","ull",NULL };
-            char **p = valid_suffix;
-            while (*p) {
-                if (strcmp(*p, &token_value[suffix_start_index]) == 0) {
-                    break;
-                }
-
-                p++;
-            }
-
-            if (*p == NULL)
-            {
-                fprintf(stderr, 
-                    "Invalid suffix '%s' in number literal on line %lu, col %lu\n", 
-                    &token_value[suffix_start_index], token->line, token->col);
-                exit(EXIT_FAILURE);
-            }
-        }
-        
+        // bytes already searched are kept at the front of the new window
+        search = lexer->length - lexer->position;
+        lexer_refill(lexer);
     }
-    
-    return token;
 }
 
-Token *lexer_scan(Lexer *lexer) {
-    while (isspace(lexer_peek(lexer)) || lexer_peek(lexer) == '\t') {
-        lexer_advance(lexer);
+// pull one token, returns 0 once the input is exhausted. works on both
+// whole sources and streams, tokens are dropped from the token buffer as
+// they are handed out so memory does not grow with the input
+int lexer_next(Lexer *lexer, Token *token) {
+    while (lexer->next_token >= lexer->tokens.count) {
+        token_buffer_clear(&lexer->tokens);
+        lexer->next_token = 0;
+
+        lexer_fill_line(lexer);
+        if (lexer->in_comment) {
+            skip_block_comment(lexer);
+            continue;
+        }
+        if (lexer->position >= lexer->length) {
+            lexer_locate_diagnostics(lexer);
+            return 0;
+        }
+
+        lexer_scan(lexer);
     }
 
-    Token *token = NULL;
+    *token = token_at(lexer, lexer->next_token++);
+    return 1;
+}
 
-    switch (lexer_peek(lexer)) {
-        case '/':
-            int look_ahead = lexer->position + 1;
-            if (look_ahead < 1024 && lexer->source[look_ahead] == '/')
-            {
-                while (!is_terminating(lexer_peek(lexer)))
-                {
-                    lexer_advance(lexer);
-                }
+// drop all tokens but keep the token arrays so the next file can be
+// scanned without going back to malloc
+void lexer_reset(Lexer *lexer) {
+    token_buffer_clear(&lexer->tokens);
+    diagnostic_list_clear(&lexer->diagnostics);
+    line_index_clear(&lexer->lines);
 
-                return NULL;
-            }
-            else {
-                token = create_token(lexer, TOKEN_FORWARDSLASH, "/");
-            }
-            
-            break;
+    lexer->position = 0;
+    lexer->source = NULL;
+    lexer->length = 0;
+    lexer->base = 0;
+    lexer->refill = NULL;
+    lexer->refill_context = NULL;
+    lexer->input_done = 1;
+    lexer->line_end = 0;
+    lexer->in_comment = 0;
+    lexer->next_token = 0;
+    lexer->located = 0;
+}
 
-        case '{':
-            token = create_token(lexer, TOKEN_L_CURLY_BRACE, "{");
-            break;
+void lexer_cleanup(Lexer *lexer) {
+    token_buffer_free(&lexer->tokens);
+    diagnostic_list_free(&lexer->diagnostics);
+    line_index_free(&lexer->lines);
+}
 
-        case '}':
-            token = create_token(lexer, TOKEN_R_CURLY_BRACE, "}");
-            break;
+Token create_token(Lexer *lexer, TokenType type, size_t start, size_t length) {
+    Token token = {
+        .offset = lexer->base + start,
+        .length = length,
+        .type = type,
+    };
+
+    STATS_BEGIN(timer);
+    token_buffer_push(&lexer->tokens, type, token.offset, token.length);
+    STATS_END(timer, STAT_CREATE_TOKEN);
+    STATS_TOKEN(type);
+    return token;
+}
 
-        case '(':
-            token = create_token(lexer, TOKEN_L_BRACE, "(");
-            break;
+Token scan_alphabets(Lexer *lexer) {
+    size_t start = lexer->position;
+    skip_run(lexer, CHAR_IDENT, simd.ident);
 
-        case ')':
-            token = create_token(lexer, TOKEN_R_BRACE, ")");
-            break;
+    size_t length = lexer->position - start;
 
-        case ';':
-            token = create_token(lexer, TOKEN_SEMICOLON, ";");
-            break;
+    STATS_BEGIN(timer);
+    int keyword = is_keyword(&lexer->source[start], length);
+    STATS_END(timer, STAT_KEYWORD);
 
-        case ',':
-            token = create_token(lexer, TOKEN_COMMA, ",");
-            break;
-        
-        case '.':
-            token = create_token(lexer, TOKEN_DOT, ".");
-            break;
+    if (keyword)
+    {
+        return create_token(lexer, TOKEN_KEYWORD, start, length);
+    }
 
-        case '+':
-            token = create_token(lexer, TOKEN_PLUS, "+");
-            break;
+    Token token = create_token(lexer, TOKEN_IDENTIFIER, start, length);
+    if (lexer->symbols) {
+        STATS_BEGIN(timer);
+        token.payload = intern(lexer->symbols, &lexer->source[start], length);
+        lexer->tokens.payloads[lexer->tokens.count - 1] = token.payload;
+        STATS_END(timer, STAT_INTERN);
+    }
+    return token;
+}
 
-        case '-':
-            token = create_token(lexer, TOKEN_MINUS, "-");
-            break;
+// records an error for the token starting at start, its line and col are
+// filled in later by lexer_locate_diagnostics
+static void lexer_error(Lexer *lexer, Diagnostic_code code, size_t start, const char *format, ...) {
+    Diagnostic *diagnostic = diagnostic_list_push(&lexer->diagnostics);
+    diagnostic->offset = lexer->base + start;
+    diagnostic->code = code;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(diagnostic->message, sizeof diagnostic->message, format, args);
+    va_end(args);
+}
 
-        case '=':
-            token = create_token(lexer, TOKEN_EQUAL, "=");
-            break;
+// a bad literal is one TOKEN_INVALID covering the whole run. a good one
+// carries its NUMBER_* flags as payload and its decoded value, see number.h
+Token scan_numbers(Lexer *lexer) {
+    size_t start = lexer->position;
+    const char *text = &lexer->source[start];
+
+    // the literal is checked and decoded in place, it is not NUL terminated
+    Number number;
+    size_t length = number_scan(text, lexer->length - start, &number);
+    lexer->position += length;
+
+    if (!number.valid) {
+        const char *at = text + number.error_at;
+        switch (number.error) {
+            case DIAGNOSTIC_NUMBER_SUFFIX:
+                lexer_error(lexer, number.error, start, "Invalid suffix '%.*s' in number literal",
+                            number.error_length > 32 ? 32 : (int)number.error_length, at);
+                break;
+            case DIAGNOSTIC_HEX_DIGIT:
+                lexer_error(lexer, number.error, start, "Invalid character '%c' in hex literal", *at);
+                break;
+            case DIAGNOSTIC_BINARY_DIGIT:
+                lexer_error(lexer, number.error, start, "Invalid character '%c' in binary literal", *at);
+                break;
+            case DIAGNOSTIC_OCTAL_DIGIT:
+                lexer_error(lexer, number.error, start, "Invalid character '%c' in octal literal", *at);
+                break;
+            default:
+                lexer_error(lexer, number.error, start, "Invalid character '%c' in number literal", *at);
+                break;
+        }
+        return create_token(lexer, TOKEN_INVALID, start, length);
+    }
 
-        case ':':
-            token = create_token(lexer, TOKEN_COLON, ":");
-            break;
+    Token token = create_token(lexer, TOKEN_NUMBER_LITERAL, start, length);
+    token.payload = number.flags;
+    token.value = number.value;
+    lexer->tokens.payloads[lexer->tokens.count - 1] = number.flags;
+    lexer->tokens.values[lexer->tokens.count - 1] = number.value;
+    return token;
+}
 
-        case '*':
-            token = create_token(lexer, TOKEN_ASTERISK, "*");
-            break;
+// a string or char literal: opening quote, body, closing quote. the body
+// cannot contain its quote or run past the end of the line. a bad literal
+// is a single TOKEN_INVALID from the opening quote up to where the body
+// stopped (the end of the line for an unterminated one), so a lexer_scan
+// call that fails still starts and ends where a good one would
+static int scan_quoted(Lexer *lexer, TokenType quote, TokenType literal, uint16_t body) {
+    size_t open = lexer->position;
+    char closing = lexer_peek(lexer);
+    lexer_advance(lexer);
 
-        case '|':
-            token = create_token(lexer, TOKEN_PIPE, "|");
-            break;
+    size_t start = lexer->position;
+    skip_class(lexer, body);
+    size_t length = lexer->position - start;
 
-        case '&':
-            token = create_token(lexer, TOKEN_AMPERSAND, "&");
-            break;
+    // the run stops at the closing quote or at the end of the line
+    if (lexer_peek(lexer) != closing)
+    {
+        if (literal == TOKEN_STRING_LITERAL) {
+            lexer_error(lexer, DIAGNOSTIC_UNTERMINATED_STRING, open,
+                        "missing terminating \" character for string literal");
+        }
+        else {
+            lexer_error(lexer, DIAGNOSTIC_UNTERMINATED_CHAR, open,
+                        "missing terminating \' character for char literal");
+        }
+        create_token(lexer, TOKEN_INVALID, open, lexer->position - open);
+        return 1;
+    }
 
-        case '!':
-            token = create_token(lexer, TOKEN_EXCLAMATION, "!");
-            break;
+    if (literal == TOKEN_CHAR_LITERAL && length > 1)
+    {
+        lexer_advance(lexer);
+        lexer_error(lexer, DIAGNOSTIC_MULTI_CHAR, open, "multi-character character literal");
+        create_token(lexer, TOKEN_INVALID, open, lexer->position - open);
+        return 1;
+    }
 
-        case '#':
-            token = create_token(lexer, TOKEN_HASHTAG, "#");
-            break;
+    // only created once the literal is known to be good
+    create_token(lexer, quote, open, 1);
+    create_token(lexer, literal, start, length);
+    create_token(lexer, quote, lexer->position, 1);
+    lexer_advance(lexer);
+    return 3;
+}
 
-        case '<':
-            token = create_token(lexer, TOKEN_L_ANGLE_BRACE, "<");
-            break;
+// operators and punctuators, the longest one that matches
+static void scan_operator(Lexer *lexer) {
+    size_t start = lexer->position;
+    TokenType type = TOKEN_INVALID;
+    size_t length = operator_match(&lexer->source[start], lexer->length - start, &type);
 
-        case '>':
-            token = create_token(lexer, TOKEN_R_ANGLE_BRACE, ">");
-            break;
+    create_token(lexer, type, start, length);
+    lexer->position += length;
+}
 
-        case '[':
-            token = create_token(lexer, TOKEN_L_SQUARE_BRACE, "[");
-            break;
+// table driven: the class of the first byte picks a state, states that
+// consume a run loop on a char_class mask
+int lexer_scan(Lexer *lexer) {
+    // newlines are left for the state below, they end the line a lexer_scan
+    // call may read up to
+    STATS_BEGIN(timer);
+    skip_run(lexer, CHAR_SPACE, simd.space);
+    STATS_END(timer, STAT_WHITESPACE);
 
-        case ']':
-            token = create_token(lexer, TOKEN_R_SQUARE_BRACE, "]");
-            break;
+    unsigned char ch = lexer_peek(lexer);
 
-        case '?':
-            token = create_token(lexer, TOKEN_QUESTIONMARK, "?");
-            break;
+    switch ((Scan_state)start_state[ch]) {
+        case STATE_NEWLINE:
+            lexer_advance(lexer);
+            return 0;
 
-        case '\"':
-            token = create_token(lexer, TOKEN_DOUBLE_QUOTE, "\"");
+        case STATE_END:
+            // hit end of input, a stray NUL inside the file is reported as invalid
+            if (lexer_at_end(lexer)) {
+                return 0;
+            }
             break;
 
-        case '\'':
-            token = create_token(lexer, TOKEN_SINGLE_QUOTE, "\'");
-            break;
+        case STATE_IDENTIFIER: {
+            STATS_BEGIN(timer);
+            scan_alphabets(lexer);
+            STATS_END(timer, STAT_IDENTIFIER);
+            return 1;
+        }
 
-        case '%':
-            token = create_token(lexer, TOKEN_MODULO, "%");
-            break;
+        case STATE_NUMBER: {
+            STATS_BEGIN(timer);
+            scan_numbers(lexer);
+            STATS_END(timer, STAT_NUMBER);
+            return 1;
+        }
 
-        case '^':
-            token = create_token(lexer, TOKEN_XOR, "^");
-            break;
+        case STATE_PUNCTUATION:
+            scan_operator(lexer);
+            return 1;
+
+        case STATE_SLASH: {
+            size_t look_ahead = lexer->position + 1;
+            if (look_ahead < lexer->length && lexer->source[look_ahead] == '/') {
+                STATS_BEGIN(timer);
+                skip_run(lexer, CHAR_COMMENT, simd.comment);
+                STATS_END(timer, STAT_COMMENT);
+                return 0;
+            }
 
-        case '\n':
-            lexer->line++;
-            lexer->col = 1;
-            lexer_advance(lexer);
-            break;
+            if (look_ahead < lexer->length && lexer->source[look_ahead] == '*') {
+                STATS_BEGIN(timer);
+                scan_block_comment(lexer);
+                STATS_END(timer, STAT_COMMENT);
+                return 0;
+            }
 
-        case '\r':
-            lexer_advance(lexer);
-            break;
+            scan_operator(lexer);
+            return 1;
+        }
 
-        case '\0':
-            // hit end of line
-            return NULL;
+        case STATE_STRING:
+        case STATE_CHAR: {
+            STATS_BEGIN(timer);
+            int count = ch == '"' ? scan_quoted(lexer, TOKEN_DOUBLE_QUOTE, TOKEN_STRING_LITERAL, CHAR_STRING)
+                                  : scan_quoted(lexer, TOKEN_SINGLE_QUOTE, TOKEN_CHAR_LITERAL, CHAR_CHAR);
+            STATS_END(timer, STAT_LITERAL);
+            return count;
+        }
 
-        default:
+        case STATE_INVALID:
             break;
     }
 
-    // check if the token scanned was a double quote if yes
-    // scan until the next double quote appears or EOF or \0 appears
-    if (token && token->type == TOKEN_DOUBLE_QUOTE)
-    {
-        lexer_advance(lexer); // move one character ahead first
+    create_token(lexer, TOKEN_INVALID, lexer->position, 1);
+    lexer_advance(lexer);
+    return 1;
+}
 
-        char token_value[MAX_ID_LEN];
-        memset(token_value, '\0', MAX_ID_LEN);
+// the token buffer is sized from the input length so large files
+// dont pay for repeated doubling
+size_t lexer_scan_all(Lexer *lexer) {
+    size_t before = lexer->tokens.count;
 
-        size_t start = lexer->position;
-        while (lexer_peek(lexer) != '\"' && !is_terminating(lexer_peek(lexer)))
-        {
-            lexer_advance(lexer);
-        }
-        
-        strncpy(token_value, &lexer->source[start], lexer->position - start);
-        
-        // scan string literal but dont update the current token
-        Token *string_literal_token = create_token(lexer, TOKEN_STRING_LITERAL, token_value);
-
-        if (is_terminating(lexer_peek(lexer)))
-        {
-            fprintf(stderr,
-                    "missing terminating \" character for string literal at Ln %lu, Col %lu\n", 
-                    string_literal_token->line, string_literal_token->col);
-            exit(EXIT_FAILURE);
-        }
-        else{
-            token = create_token(lexer, TOKEN_DOUBLE_QUOTE, "\"");
-        }
-        lexer_advance(lexer);
+    if (token_buffer_reserve(&lexer->tokens, before + (lexer->length - lexer->position) / 4) < 0) {
+        perror("lexer_scan_all");
+        exit(EXIT_FAILURE);
     }
-    else if (token && token->type == TOKEN_SINGLE_QUOTE)
-    {
-        // this part is same as that for string literal but we just
-        // check for a ' and we check if length of literal is more than 1 and report an error
-        lexer_advance(lexer);
-
-        char token_value[MAX_ID_LEN];
-        memset(token_value, '\0', MAX_ID_LEN);
-
-        size_t start = lexer->position;
-        while (lexer_peek(lexer) != '\'' && !is_terminating(lexer_peek(lexer)))
-        {
-            lexer_advance(lexer);
-        }
 
-        strncpy(token_value, &lexer->source[start], lexer->position - start);
-        
-        Token *char_literal_token = create_token(lexer, TOKEN_CHAR_LITERAL, token_value);
-
-        if (is_terminating(lexer_peek(lexer)))
-        {
-            fprintf(stderr,
-                    "missing terminating \' character for char literal at Ln %lu, Col %lu\n", 
-                    char_literal_token->line, char_literal_token->col);
-            exit(EXIT_FAILURE);
-        }
-        else if (strlen(token_value) > 1)
-        {
-            fprintf(stderr, 
-                    "multi-character character literal at Ln %lu, Col %lu \n",
-                    char_literal_token->line, char_literal_token->col);
-            exit(EXIT_FAILURE);
-        }
-        else{
-            token = create_token(lexer, TOKEN_SINGLE_QUOTE, "\'");
-        }
-        lexer_advance(lexer);
-
-    }
-    else if (token == NULL && (isalpha(lexer_peek(lexer)) || lexer_peek(lexer) == '_')) {
-        token = scan_alphabets(lexer);
-    } 
-    else if (token == NULL && isdigit(lexer_peek(lexer))) {
-        token = scan_numbers(lexer);
-    }
-    else if (token == NULL) {
-        token = create_token(lexer, TOKEN_INVALID, "");
-        lexer_advance(lexer);
-    } else {
-        lexer_advance(lexer);
+    while (lexer->position < lexer->length) {
+        lexer_scan(lexer);
     }
+    lexer_locate_diagnostics(lexer);
 
-    return token;
+    return lexer->tokens.count - before;
 }
 
-
-
 const char *get_token_name(TokenType type) {
     switch (type) {
         case TOKEN_IDENTIFIER:
@@ -692,6 +724,78 @@ const char *get_token_name(TokenType type) {
         case TOKEN_CHAR_LITERAL:
             return "TOKEN_CHAR_LITERAL";
 
+        case TOKEN_TILDE:
+            return "TOKEN_TILDE";
+
+        case TOKEN_ELLIPSIS:
+            return "TOKEN_ELLIPSIS";
+
+        case TOKEN_ARROW:
+            return "TOKEN_ARROW";
+
+        case TOKEN_INCREMENT:
+            return "TOKEN_INCREMENT";
+
+        case TOKEN_DECREMENT:
+            return "TOKEN_DECREMENT";
+
+        case TOKEN_PLUS_EQUAL:
+            return "TOKEN_PLUS_EQUAL";
+
+        case TOKEN_MINUS_EQUAL:
+            return "TOKEN_MINUS_EQUAL";
+
+        case TOKEN_ASTERISK_EQUAL:
+            return "TOKEN_ASTERISK_EQUAL";
+
+        case TOKEN_FORWARDSLASH_EQUAL:
+            return "TOKEN_FORWARDSLASH_EQUAL";
+
+        case TOKEN_MODULO_EQUAL:
+            return "TOKEN_MODULO_EQUAL";
+
+        case TOKEN_EQUAL_EQUAL:
+            return "TOKEN_EQUAL_EQUAL";
+
+        case TOKEN_NOT_EQUAL:
+            return "TOKEN_NOT_EQUAL";
+
+        case TOKEN_LOGICAL_AND:
+            return "TOKEN_LOGICAL_AND";
+
+        case TOKEN_AMPERSAND_EQUAL:
+            return "TOKEN_AMPERSAND_EQUAL";
+
+        case TOKEN_LOGICAL_OR:
+            return "TOKEN_LOGICAL_OR";
+
+        case TOKEN_PIPE_EQUAL:
+            return "TOKEN_PIPE_EQUAL";
+
+        case TOKEN_XOR_EQUAL:
+            return "TOKEN_XOR_EQUAL";
+
+        case TOKEN_LESS_EQUAL:
+            return "TOKEN_LESS_EQUAL";
+
+        case TOKEN_LEFT_SHIFT:
+            return "TOKEN_LEFT_SHIFT";
+
+        case TOKEN_LEFT_SHIFT_EQUAL:
+            return "TOKEN_LEFT_SHIFT_EQUAL";
+
+        case TOKEN_GREATER_EQUAL:
+            return "TOKEN_GREATER_EQUAL";
+
+        case TOKEN_RIGHT_SHIFT:
+            return "TOKEN_RIGHT_SHIFT";
+
+        case TOKEN_RIGHT_SHIFT_EQUAL:
+            return "TOKEN_RIGHT_SHIFT_EQUAL";
+
+        case TOKEN_DOUBLE_HASHTAG:
+            return "TOKEN_DOUBLE_HASHTAG";
+
         case TOKEN_EOF:
             return "TOKEN_EOF";
 
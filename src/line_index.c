@@ -0,0 +1,156 @@
+#include "line_index.h"
+#include "simd.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_INDEX_MIN_CAPACITY 64
+
+// newlines are indexed this many bytes at a time, each piece reserves
+// room for a start per byte so the kernel never checks for space
+#define LINE_INDEX_PIECE (64 * 1024)
+
+static void line_index_reserve(Line_index *index, size_t capacity) {
+    if (capacity <= index->capacity) return;
+
+    size_t grown_capacity = index->capacity ? index->capacity * 2 : LINE_INDEX_MIN_CAPACITY;
+    while (grown_capacity < capacity) grown_capacity *= 2;
+
+    uint32_t *grown = realloc(index->starts, sizeof(uint32_t) * grown_capacity);
+    if (!grown) {
+        perror("line_index");
+        exit(EXIT_FAILURE);
+    }
+    STATS_ALLOC(sizeof(uint32_t) * grown_capacity);
+
+    index->starts = grown;
+    index->capacity = grown_capacity;
+}
+
+void line_index_initialize(Line_index *index) {
+    simd_initialize();
+
+    index->starts = NULL;
+    index->capacity = 0;
+    line_index_reserve(index, LINE_INDEX_MIN_CAPACITY);
+    line_index_clear(index);
+}
+
+// back to an empty input, line 1 starts at offset 0
+void line_index_clear(Line_index *index) {
+    index->starts[0] = 0;
+    index->count = 1;
+    index->first_line = 1;
+    index->scanned = 0;
+    index->hint = 0;
+}
+
+// indexes the newlines of data, data[0] is the byte at offset scanned
+void line_index_scan(Line_index *index, const char *data, size_t length) {
+    while (length > 0) {
+        size_t piece = length < LINE_INDEX_PIECE ? length : LINE_INDEX_PIECE;
+
+        line_index_reserve(index, index->count + piece);
+        index->count += simd.lines(data, piece, (uint32_t)index->scanned, index->starts + index->count);
+        index->scanned += piece;
+        data += piece;
+        length -= piece;
+    }
+}
+
+// index of the last line starting at or before offset
+static size_t find_line(Line_index *index, uint32_t offset) {
+    const uint32_t *starts = index->starts;
+    size_t hint = index->hint;
+
+    if (hint < index->count && starts[hint] <= offset) {
+        if (hint + 1 == index->count || offset < starts[hint + 1]) return hint;
+        if (hint + 2 == index->count || offset < starts[hint + 2]) return hint + 1;
+    }
+
+    size_t low = 0, high = index->count;
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if (starts[mid] <= offset) {
+            low = mid;
+        }
+        else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// the newlines before offset must have been scanned
+Source_position line_index_find(Line_index *index, uint32_t offset) {
+    size_t line = find_line(index, offset);
+    index->hint = line;
+
+    Source_position position = {
+        .line = index->first_line + (uint32_t)line,
+        .col = offset - index->starts[line] + 1,
+    };
+    return position;
+}
+
+// forgets the lines before the one holding offset, a stream keeps only
+// the lines of its window
+void line_index_drop(Line_index *index, uint32_t offset) {
+    size_t line = find_line(index, offset);
+    if (line == 0) return;
+
+    memmove(index->starts, index->starts + line, (index->count - line) * sizeof(uint32_t));
+    index->count -= line;
+    index->first_line += line;
+    index->hint = 0;
+}
+
+// the text [offset, offset + removed) was replaced by inserted: its line
+// starts are swapped and the ones after it shifted, like the tokens of an
+// incremental edit. an edit past what was scanned only moves scanned back
+void line_index_edit(Line_index *index, uint32_t offset, uint32_t removed, const char *inserted,
+                     uint32_t inserted_length) {
+    index->hint = 0;
+    if (index->scanned <= offset) return;
+
+    // starts after offset up to and including offset + removed came from
+    // newlines inside the removed text
+    size_t from = find_line(index, offset) + 1;
+    if (index->scanned < (size_t)offset + removed) {
+        index->count = from;
+        index->scanned = offset;
+        return;
+    }
+    size_t to = from;
+    while (to < index->count && index->starts[to] <= offset + removed) to++;
+
+    size_t added = 0;
+    for (uint32_t i = 0; i < inserted_length; i++) {
+        added += inserted[i] == '\n';
+    }
+
+    size_t tail = index->count - to;
+    line_index_reserve(index, from + added + tail);
+    memmove(index->starts + from + added, index->starts + to, tail * sizeof(uint32_t));
+
+    uint32_t *start = index->starts + from;
+    for (uint32_t i = 0; i < inserted_length; i++) {
+        if (inserted[i] == '\n') *start++ = offset + i + 1;
+    }
+
+    uint32_t shift = inserted_length - removed;
+    for (size_t i = from + added; i < from + added + tail; i++) {
+        index->starts[i] += shift;
+    }
+
+    index->count = from + added + tail;
+    index->scanned = index->scanned - removed + inserted_length;
+}
+
+void line_index_free(Line_index *index) {
+    free(index->starts);
+    index->starts = NULL;
+    index->count = index->capacity = 0;
+}
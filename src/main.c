@@ -1,54 +1,533 @@
+#include <errno.h>
 #include <fcntl.h>
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "driver.h"
+#include "input.h"
 #include "lexer.h"
-#define BUFFER_LEN 1024
+#include "printer.h"
+#include "stats.h"
+#include "token_cache.h"
+#include "token_file.h"
 
-int main(int argc, char **argv) {
-    if (argc < 2) {
-        fprintf(stderr, "Expected a file name as an argument\n");
-        exit(EXIT_FAILURE);
+static void usage(FILE *out, const char *program) {
+    fprintf(out,
+            "usage: %s [options] <file|directory|->...\n"
+            "\n"
+            "With a single file the token stream is printed. With several inputs,\n"
+            "directories or any of the options below the files are lexed in parallel.\n"
+            "\n"
+            "  -j, --jobs N          number of worker threads (default: online cores)\n"
+            "  -l, --files-from F    read input paths from F, one per line (- for stdin)\n"
+            "  -p, --print           print the token stream of every file\n"
+            "  -c, --count           only print the token count of every file\n"
+            "  -s, --stream          read a single input block by block instead of\n"
+            "                        loading it whole (always done for -)\n"
+            "  -b, --block-size N    stream read block size, K and M suffixes allowed\n"
+            "                        (default 256K)\n"
+            "  -f, --format F        text (default), tsv, jsonl or binary, see\n"
+            "                        token_file.h for the binary layout\n"
+            "      --color[=WHEN]    color token text: auto (default, on a terminal),\n"
+            "                        always or never\n"
+            "  -o, --output F        write the single input's tokens to F (- for stdout)\n"
+            "      --dump F          print a binary token file as text\n"
+            "      --stats[=json]    print phase timings, token counts and allocations\n"
+            "                        on stderr (needs a build with make STATS=1)\n"
+            "      --cache DIR       reuse the tokens of files lexed before, keyed by a\n"
+            "                        hash of their contents\n"
+            "      --cache-size N    evict the least recently used cache entries past N,\n"
+            "                        K, M and G suffixes allowed (default 256M)\n"
+            "      --symbols         intern identifiers into one table for all inputs,\n"
+            "                        jsonl gives every identifier its symbol id\n"
+            "      --follow-includes lex the headers the inputs #include too, every\n"
+            "                        header once however often it is included\n"
+            "  -I, --include-dir DIR search DIR for #include files, implies\n"
+            "                        --follow-includes\n"
+            "  -h, --help            show this help\n",
+            program);
+}
+
+// after the tokens so the two never interleave on a terminal. returns
+// the exit status of a single file run
+static int report_diagnostics(const char *file_name, Lexer *lexer, Printer *printer) {
+    if (printer) {
+        printer_flush(printer);
     }
+    fflush(stdout);
 
+    const char *path = strcmp(file_name, "-") == 0 ? "<stdin>" : file_name;
+    for (size_t i = 0; i < lexer->diagnostics.count; i++) {
+        diagnostic_print(stderr, path, &lexer->diagnostics.items[i]);
+    }
+
+    return lexer->diagnostics.count > 0 ? EXIT_FAILURE : 0;
+}
+
+// the whole file is handed to the lexer at once so it is scanned in a
+// single pass, tokens can never be split by a read boundary. tokens are
+// pulled and printed one at a time so they are never all held at once
+static int print_file(const char *file_name, Printer *printer, Intern_table *symbols) {
     Lexer lexer;
     lexer_initialize(&lexer);
+    lexer_set_symbols(&lexer, symbols);
+
+    Source_file file;
+    if (source_file_open(file_name, &file) < 0) {
+        perror(file_name);
+        exit(EXIT_FAILURE);
+    }
+
+    lexer_set_source(&lexer, file.data, file.length);
+
+    Token token;
+    while (lexer_next(&lexer, &token)) {
+        printer_token(printer, &lexer, &token);
+    }
+    printer_end(printer);
+    int result = report_diagnostics(file_name, &lexer, printer);
+
+    lexer_cleanup(&lexer);
+    source_file_close(&file);
+
+    return result;
+}
 
-    char *file_name = argv[1];
+// same output as print_file but the input is never held whole, only
+// the unconsumed part of the current line plus one read block
+static int stream_file(const char *file_name, size_t block_size, Printer *printer, Intern_table *symbols) {
+    Lexer lexer;
+    lexer_initialize(&lexer);
+    lexer_set_symbols(&lexer, symbols);
 
-    FILE *fp = fopen(file_name, "r");
-    if (!fp) {
-        perror("fopen");
+    Source_stream stream;
+    if (source_stream_open(file_name, block_size, &stream) < 0) {
+        perror(file_name);
         exit(EXIT_FAILURE);
     }
 
-    char buffer[BUFFER_LEN];
-    memset(buffer, '\0', BUFFER_LEN);
+    lexer_set_refill(&lexer, source_stream_refill, &stream);
 
-    char *res = fgets(buffer, BUFFER_LEN, fp);
-    while (res) {
-        lexer.source = buffer;
+    Token token;
+    while (lexer_next(&lexer, &token)) {
+        printer_token(printer, &lexer, &token);
+    }
+    printer_end(printer);
+    int result = report_diagnostics(file_name, &lexer, printer);
 
-        while (lexer_peek(&lexer) != '\0') {
-            lexer_scan(&lexer);
-        }
+    lexer_cleanup(&lexer);
+    source_stream_close(&stream);
+
+    return result;
+}
+
+// the whole token stream is kept so it can go out in one write
+static int write_binary(const char *file_name, const char *output) {
+    int fd = STDOUT_FILENO;
+    if (strcmp(output, "-") != 0) {
+        fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    else if (isatty(STDOUT_FILENO)) {
+        fprintf(stderr, "refusing to write binary tokens to a terminal, use -o\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (fd < 0) {
+        perror(output);
+        exit(EXIT_FAILURE);
+    }
 
-        lexer.position = 0;
-        lexer.col = 1;
-        lexer.line++;
+    Lexer lexer;
+    lexer_initialize(&lexer);
 
-        memset(buffer, '\0', BUFFER_LEN);
-        res = fgets(buffer, BUFFER_LEN, fp);
+    Source_file file;
+    if (source_file_open(file_name, &file) < 0) {
+        perror(file_name);
+        exit(EXIT_FAILURE);
     }
 
-    print_tokens(&lexer);
+    lexer_set_source(&lexer, file.data, file.length);
+    lexer_scan_all(&lexer);
+
+    if (token_file_write(fd, &lexer) < 0 || (fd != STDOUT_FILENO && close(fd) < 0)) {
+        perror(output);
+        exit(EXIT_FAILURE);
+    }
+    int result = report_diagnostics(file_name, &lexer, NULL);
 
     lexer_cleanup(&lexer);
-    if (fp != NULL)
-    {
-        fclose(fp);
+    source_file_close(&file);
+
+    return result;
+}
+
+// the records are printed straight from the mapping, the lexer only
+// lends the printer the string table
+static int dump_file(const char *path, Printer *printer) {
+    Token_file file;
+    if (token_file_open(path, &file) < 0) {
+        if (errno == EINVAL) {
+            fprintf(stderr, "%s: not a well formed version %d token file\n", path, TOKEN_FILE_VERSION);
+        }
+        else {
+            perror(path);
+        }
+        exit(EXIT_FAILURE);
     }
-    
+
+    Lexer lexer;
+    lexer_initialize(&lexer);
+    lexer_set_source(&lexer, file.strings, file.header->strings_size);
+
+    for (size_t i = 0; i < file.count; i++) {
+        const Token_record *record = &file.records[i];
+        Token token = {
+            .offset = record->offset,
+            .length = record->length,
+            .type = record->type,
+        };
+        printer_token(printer, &lexer, &token);
+    }
+    printer_end(printer);
+
+    lexer_cleanup(&lexer);
+    token_file_close(&file);
+
     return 0;
-}
\ No newline at end of file
+}
+
+static size_t parse_size(const char *text, const char *what, size_t minimum) {
+    char *end;
+    unsigned long long size = strtoull(text, &end, 10);
+
+    if (*end == 'k' || *end == 'K') {
+        size *= 1024;
+        end++;
+    }
+    else if (*end == 'm' || *end == 'M') {
+        size *= 1024 * 1024;
+        end++;
+    }
+    else if (*end == 'g' || *end == 'G') {
+        size *= 1024 * 1024 * 1024;
+        end++;
+    }
+
+    if (end == text || *end != '\0' || size < minimum) {
+        fprintf(stderr, "invalid %s '%s', expected at least %zuK\n", what, text, minimum / 1024);
+        exit(EXIT_FAILURE);
+    }
+    return size;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int is_directory(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// sets up headers the first time an option needs it, returns the new
+// follow_includes
+static int use_headers(Header_cache *headers, int follow_includes) {
+    if (!follow_includes && header_cache_initialize(headers) < 0) {
+        perror("header_cache_initialize");
+        exit(EXIT_FAILURE);
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    static struct option long_options[] = {
+        {"jobs", required_argument, NULL, 'j'},
+        {"files-from", required_argument, NULL, 'l'},
+        {"print", no_argument, NULL, 'p'},
+        {"count", no_argument, NULL, 'c'},
+        {"stream", no_argument, NULL, 's'},
+        {"block-size", required_argument, NULL, 'b'},
+        {"stats", optional_argument, NULL, 'S'},
+        {"format", required_argument, NULL, 'f'},
+        {"color", optional_argument, NULL, 'C'},
+        {"output", required_argument, NULL, 'o'},
+        {"dump", required_argument, NULL, 'D'},
+        {"cache", required_argument, NULL, 'K'},
+        {"cache-size", required_argument, NULL, 'Z'},
+        {"symbols", no_argument, NULL, 'Y'},
+        {"follow-includes", no_argument, NULL, 'F'},
+        {"include-dir", required_argument, NULL, 'I'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    Driver_options options = { .jobs = 0, .print = -1, .cache = NULL, .symbols = NULL, .headers = NULL };
+    Driver_file_list list;
+    driver_file_list_initialize(&list);
+    int driver_mode = 0;
+    int stream = 0;
+    size_t block_size = STREAM_BLOCK_DEFAULT;
+    int stats = 0, stats_json = 0;
+    int binary = 0;
+    Print_format format = PRINT_PRETTY;
+    int color = isatty(STDOUT_FILENO);
+    const char *dump = NULL;
+    const char *cache_dir = NULL;
+    size_t cache_limit = TOKEN_CACHE_DEFAULT_LIMIT;
+    int intern_symbols = 0;
+    // the header cache is only set up once -I or --follow-includes asks for it
+    int follow_includes = 0;
+    Header_cache headers;
+    const char *output = NULL;
+    double start = now_seconds();
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "j:l:pcsb:f:o:I:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'j':
+                options.jobs = atoi(optarg);
+                if (options.jobs < 1) {
+                    fprintf(stderr, "invalid job count '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                driver_mode = 1;
+                break;
+
+            case 'l':
+                if (driver_add_list_file(&list, optarg) < 0) {
+                    perror(optarg);
+                    exit(EXIT_FAILURE);
+                }
+                driver_mode = 1;
+                break;
+
+            case 'p':
+                options.print = 1;
+                break;
+
+            case 'c':
+                options.print = 0;
+                driver_mode = 1;
+                break;
+
+            case 's':
+                stream = 1;
+                break;
+
+            case 'b':
+                block_size = parse_size(optarg, "block size", STREAM_BLOCK_MIN);
+                stream = 1;
+                break;
+
+            case 'S':
+                if (optarg && strcmp(optarg, "json") != 0) {
+                    fprintf(stderr, "invalid stats format '%s', expected json\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                if (!stats_enabled()) {
+                    fprintf(stderr, "--stats needs a build with LEXER_STATS, rebuild with make STATS=1\n");
+                    exit(EXIT_FAILURE);
+                }
+                stats = 1;
+                stats_json = optarg != NULL;
+                break;
+
+            case 'f':
+                if (strcmp(optarg, "binary") == 0) {
+                    binary = 1;
+                }
+                else if (strcmp(optarg, "tsv") == 0) {
+                    format = PRINT_TSV;
+                }
+                else if (strcmp(optarg, "jsonl") == 0) {
+                    format = PRINT_JSONL;
+                }
+                else if (strcmp(optarg, "text") != 0) {
+                    fprintf(stderr, "invalid format '%s', expected text, tsv, jsonl or binary\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'C':
+                if (!optarg || strcmp(optarg, "always") == 0) {
+                    color = 1;
+                }
+                else if (strcmp(optarg, "never") == 0) {
+                    color = 0;
+                }
+                else if (strcmp(optarg, "auto") == 0) {
+                    color = isatty(STDOUT_FILENO);
+                }
+                else {
+                    fprintf(stderr, "invalid color mode '%s', expected auto, always or never\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'o':
+                output = optarg;
+                break;
+
+            case 'D':
+                dump = optarg;
+                break;
+
+            case 'K':
+                cache_dir = optarg;
+                driver_mode = 1;
+                break;
+
+            case 'Z':
+                cache_limit = parse_size(optarg, "cache size", 1024);
+                break;
+
+            case 'Y':
+                intern_symbols = 1;
+                break;
+
+            case 'I':
+                follow_includes = use_headers(&headers, follow_includes);
+                if (header_cache_add_dir(&headers, optarg) < 0) {
+                    perror("header_cache_add_dir");
+                    exit(EXIT_FAILURE);
+                }
+                driver_mode = 1;
+                break;
+
+            case 'F':
+                follow_includes = use_headers(&headers, follow_includes);
+                driver_mode = 1;
+                break;
+
+            case 'h':
+                usage(stdout, argv[0]);
+                return 0;
+
+            default:
+                usage(stderr, argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    // only the pretty layout is colored
+    if (format != PRINT_PRETTY) {
+        color = 0;
+    }
+
+    Printer printer;
+    printer_initialize(&printer, stdout, format, color);
+
+    Intern_table symbols;
+    if (intern_symbols) {
+        if (intern_table_initialize(&symbols) < 0) {
+            perror("intern_table_initialize");
+            exit(EXIT_FAILURE);
+        }
+        printer.symbols = 1;
+        options.symbols = &symbols;
+    }
+
+    if (dump) {
+        int result = dump_file(dump, &printer);
+        printer_free(&printer);
+        if (follow_includes) {
+            header_cache_free(&headers);
+        }
+        return result;
+    }
+
+    int inputs = argc - optind;
+    if (inputs < 1 && list.count == 0) {
+        fprintf(stderr, "Expected a file name as an argument\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (binary || output) {
+        if (driver_mode || stream || inputs != 1 || list.count != 0 || is_directory(argv[optind])) {
+            fprintf(stderr, "--format and --output only apply to a single input file\n");
+            exit(EXIT_FAILURE);
+        }
+        if (!binary) {
+            fprintf(stderr, "--output is only supported with --format=binary\n");
+            exit(EXIT_FAILURE);
+        }
+        return write_binary(argv[optind], output ? output : "-");
+    }
+
+    // a single plain file keeps the original behaviour
+    if (!driver_mode && inputs == 1 && list.count == 0 && !is_directory(argv[optind])) {
+        int result = stream || strcmp(argv[optind], "-") == 0
+                         ? stream_file(argv[optind], block_size, &printer, options.symbols)
+                         : print_file(argv[optind], &printer, options.symbols);
+        printer_free(&printer);
+        if (intern_symbols) {
+            intern_table_free(&symbols);
+        }
+        if (stats) {
+            fflush(stdout);
+            stats_print(stderr, stats_json, now_seconds() - start);
+        }
+        return result;
+    }
+
+    if (stream) {
+        fprintf(stderr, "--stream only applies to a single input file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = optind; i < argc; i++) {
+        if (driver_add_path(&list, argv[i]) < 0) {
+            perror(argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (options.jobs == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        options.jobs = cores > 0 ? (int)cores : 1;
+    }
+
+    if (options.print < 0) {
+        options.print = 0;
+    }
+    options.format = format;
+    options.color = color;
+
+    Token_cache cache;
+    if (cache_dir) {
+        if (token_cache_open(&cache, cache_dir, cache_limit) < 0) {
+            perror(cache_dir);
+            exit(EXIT_FAILURE);
+        }
+        options.cache = &cache;
+    }
+
+    if (follow_includes) {
+        options.headers = &headers;
+    }
+
+    int result = driver_run(&list, &options);
+    driver_file_list_free(&list);
+    if (cache_dir) {
+        token_cache_close(&cache);
+    }
+    if (follow_includes) {
+        header_cache_free(&headers);
+    }
+    if (intern_symbols) {
+        intern_table_free(&symbols);
+    }
+
+    if (stats) {
+        stats_print(stderr, stats_json, now_seconds() - start);
+    }
+
+    return result < 0 ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,221 @@
+#include "number.h"
+#include "char_class.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NONE SIZE_MAX
+
+// more decimal digits than this may not fit the 64 bit mantissa
+#define MAX_DIGITS 19
+
+// mantissas up to 2^53 and powers of ten up to 10^22 are exact doubles, a
+// product or quotient of two exact doubles is correctly rounded (Clinger)
+#define EXACT_MANTISSA (1ull << 53)
+#define EXACT_POWER 22
+
+static const double powers_of_ten[EXACT_POWER + 1] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// value = value * radix + digit, 1 once it no longer fits
+static inline int accumulate(uint64_t *value, unsigned radix, unsigned digit) {
+    return __builtin_mul_overflow(*value, radix, value) | __builtin_add_overflow(*value, digit, value);
+}
+
+// everything the fast path can not round exactly goes to strtod, on a
+// NUL terminated copy since the source may end right after the literal
+static double parse_slow(const char *text, size_t length) {
+    char buffer[128];
+    char *copy = length < sizeof buffer ? buffer : malloc(length + 1);
+    if (!copy) {
+        perror("number_scan");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    double value = strtod(copy, NULL);
+
+    if (copy != buffer) free(copy);
+    return value;
+}
+
+// f, u, l, ul, ll or ull as NUMBER_SUFFIX_* flags, -1 for anything else
+static int suffix_flags(const char *suffix, size_t length) {
+    switch (length) {
+        case 0:
+            return 0;
+
+        case 1:
+            if (suffix[0] == 'f') return NUMBER_SUFFIX_F;
+            if (suffix[0] == 'u') return NUMBER_SUFFIX_U;
+            if (suffix[0] == 'l') return NUMBER_SUFFIX_L;
+            return -1;
+
+        case 2:
+            if (suffix[0] == 'u' && suffix[1] == 'l') return NUMBER_SUFFIX_U | NUMBER_SUFFIX_L;
+            if (suffix[0] == 'l' && suffix[1] == 'l') return NUMBER_SUFFIX_LL;
+            return -1;
+
+        case 3:
+            if (memcmp(suffix, "ull", 3) == 0) return NUMBER_SUFFIX_U | NUMBER_SUFFIX_LL;
+            return -1;
+    }
+    return -1;
+}
+
+static size_t number_error(Number *number, Diagnostic_code code, size_t at, size_t length, size_t end) {
+    number->valid = 0;
+    number->error = code;
+    number->error_at = at;
+    number->error_length = length;
+    return end;
+}
+
+// reads the literal at text, text[0] is a digit, up to limit bytes. the
+// decimal and, for a leading 0, the radix reading are both kept up as the
+// bytes go by, which one counts is only known at the end: a '.' anywhere
+// makes it a decimal. returns the length of the run, a bad literal has the
+// same length as a good one would
+size_t number_scan(const char *text, size_t limit, Number *number) {
+    unsigned radix = 0;
+    size_t radix_from = 0;
+    if (text[0] == '0' && limit > 1) {
+        radix = 8;
+        radix_from = 1;
+        if (text[1] == 'x' || text[1] == 'X') {
+            radix = 16;
+            radix_from = 2;
+        }
+        else if (text[1] == 'b' || text[1] == 'B') {
+            radix = 2;
+            radix_from = 2;
+        }
+    }
+    uint64_t radix_value = 0;
+    int radix_overflow = 0;
+    size_t radix_bad = NONE;
+
+    // the integer part on its own, and the significant digits with their
+    // power of ten for a float
+    uint64_t integer = 0;
+    int integer_overflow = 0;
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0, truncated = 0;
+    size_t dots = 0;
+
+    // the decimal value stops at the first letter or the second '.'
+    size_t value_end = NONE;
+    size_t first_alpha = NONE;
+    // start of the letter run the bytes so far end in
+    size_t suffix_start = NONE;
+
+    size_t i = 0;
+    for (; i < limit; i++) {
+        unsigned char ch = text[i];
+        uint16_t class = char_class[ch];
+        if (!(class & CHAR_NUMBER)) break;
+
+        if (class & CHAR_ALPHA) {
+            if (first_alpha == NONE) first_alpha = i;
+            if (suffix_start == NONE) suffix_start = i;
+            if (value_end == NONE) value_end = i;
+        }
+        else {
+            suffix_start = NONE;
+
+            if (ch == '.') {
+                dots++;
+                if (dots == 2 && value_end == NONE) value_end = i;
+            }
+            else if (value_end == NONE) {
+                unsigned digit = ch - '0';
+                if (dots == 0) integer_overflow |= accumulate(&integer, 10, digit);
+
+                if (digits < MAX_DIGITS) {
+                    // leading zeros are not significant
+                    if (mantissa != 0 || digit != 0) {
+                        mantissa = mantissa * 10 + digit;
+                        digits++;
+                    }
+                    if (dots) exponent--;
+                }
+                else {
+                    if (!dots) exponent++;
+                    truncated |= digit != 0;
+                }
+            }
+        }
+
+        if (i >= radix_from && radix_bad == NONE && radix) {
+            unsigned digit = radix;
+            if (class & CHAR_DIGIT) {
+                digit = ch - '0';
+            }
+            else if (class & CHAR_HEX) {
+                digit = (ch | 0x20) - 'a' + 10;
+            }
+            if (digit >= radix) {
+                radix_bad = i;
+            }
+            else {
+                radix_overflow |= accumulate(&radix_value, radix, digit);
+            }
+        }
+    }
+
+    size_t length = i;
+    number->flags = 0;
+    number->value = 0;
+    number->valid = 1;
+
+    if (radix && dots == 0 && length >= 2) {
+        if (length == 2 && char_is(text[1], CHAR_ALPHA)) {
+            return number_error(number, DIAGNOSTIC_NUMBER_SUFFIX, 1, 1, length);
+        }
+
+        if (radix_bad != NONE) {
+            Diagnostic_code code = radix == 16  ? DIAGNOSTIC_HEX_DIGIT
+                                   : radix == 2 ? DIAGNOSTIC_BINARY_DIGIT
+                                                : DIAGNOSTIC_OCTAL_DIGIT;
+            return number_error(number, code, radix_bad, 1, length);
+        }
+
+        number->value = radix_overflow ? UINT64_MAX : radix_value;
+        number->flags = radix_overflow ? NUMBER_OVERFLOW : 0;
+        return length;
+    }
+
+    // only the letters the literal ends in can be a suffix
+    size_t suffix = suffix_start != NONE ? suffix_start : length;
+    if (first_alpha < suffix) {
+        return number_error(number, DIAGNOSTIC_NUMBER_CHARACTER, first_alpha, 1, length);
+    }
+
+    int flags = suffix_flags(text + suffix, length - suffix);
+    if (flags < 0) {
+        return number_error(number, DIAGNOSTIC_NUMBER_SUFFIX, suffix, length - suffix, length);
+    }
+    number->flags = flags;
+
+    if (dots == 0 && !(flags & NUMBER_SUFFIX_F)) {
+        number->value = integer_overflow ? UINT64_MAX : integer;
+        if (integer_overflow) number->flags |= NUMBER_OVERFLOW;
+        return length;
+    }
+
+    double real;
+    if (!truncated && mantissa <= EXACT_MANTISSA && exponent >= -EXACT_POWER && exponent <= EXACT_POWER) {
+        real = exponent < 0 ? (double)mantissa / powers_of_ten[-exponent]
+                            : (double)mantissa * powers_of_ten[exponent];
+    }
+    else {
+        real = parse_slow(text, value_end != NONE ? value_end : length);
+    }
+
+    memcpy(&number->value, &real, sizeof real);
+    number->flags |= NUMBER_FLOAT;
+    return length;
+}
@@ -0,0 +1,141 @@
+#include "operators.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    const char *text;
+    TokenType type;
+} Operator;
+
+static const Operator operators[] = {
+    { "{", TOKEN_L_CURLY_BRACE },
+    { "}", TOKEN_R_CURLY_BRACE },
+    { "(", TOKEN_L_BRACE },
+    { ")", TOKEN_R_BRACE },
+    { "[", TOKEN_L_SQUARE_BRACE },
+    { "]", TOKEN_R_SQUARE_BRACE },
+    { ";", TOKEN_SEMICOLON },
+    { ",", TOKEN_COMMA },
+    { ":", TOKEN_COLON },
+    { "?", TOKEN_QUESTIONMARK },
+    { "~", TOKEN_TILDE },
+    { ".", TOKEN_DOT },
+    { "...", TOKEN_ELLIPSIS },
+    { "+", TOKEN_PLUS },
+    { "++", TOKEN_INCREMENT },
+    { "+=", TOKEN_PLUS_EQUAL },
+    { "-", TOKEN_MINUS },
+    { "--", TOKEN_DECREMENT },
+    { "-=", TOKEN_MINUS_EQUAL },
+    { "->", TOKEN_ARROW },
+    { "*", TOKEN_ASTERISK },
+    { "*=", TOKEN_ASTERISK_EQUAL },
+    { "/", TOKEN_FORWARDSLASH },
+    { "/=", TOKEN_FORWARDSLASH_EQUAL },
+    { "%", TOKEN_MODULO },
+    { "%=", TOKEN_MODULO_EQUAL },
+    { "=", TOKEN_EQUAL },
+    { "==", TOKEN_EQUAL_EQUAL },
+    { "!", TOKEN_EXCLAMATION },
+    { "!=", TOKEN_NOT_EQUAL },
+    { "&", TOKEN_AMPERSAND },
+    { "&&", TOKEN_LOGICAL_AND },
+    { "&=", TOKEN_AMPERSAND_EQUAL },
+    { "|", TOKEN_PIPE },
+    { "||", TOKEN_LOGICAL_OR },
+    { "|=", TOKEN_PIPE_EQUAL },
+    { "^", TOKEN_XOR },
+    { "^=", TOKEN_XOR_EQUAL },
+    { "<", TOKEN_L_ANGLE_BRACE },
+    { "<=", TOKEN_LESS_EQUAL },
+    { "<<", TOKEN_LEFT_SHIFT },
+    { "<<=", TOKEN_LEFT_SHIFT_EQUAL },
+    { ">", TOKEN_R_ANGLE_BRACE },
+    { ">=", TOKEN_GREATER_EQUAL },
+    { ">>", TOKEN_RIGHT_SHIFT },
+    { ">>=", TOKEN_RIGHT_SHIFT_EQUAL },
+    { "#", TOKEN_HASHTAG },
+    { "##", TOKEN_DOUBLE_HASHTAG },
+    { NULL, TOKEN_INVALID },
+};
+
+// a trie over the operator bytes. bytes are renumbered densely so a node
+// is one small row of child indices, the whole table is about 1.5K and
+// stays in L1. node 0 is the root and byte index 0 is "not an operator
+// byte", so a missing edge and a foreign byte both read as child 0
+#define OPERATOR_ALPHABET 32
+#define OPERATOR_MAX_NODES 64
+#define OPERATOR_NONE 0xff
+
+static uint8_t operator_char[256];
+static uint8_t operator_child[OPERATOR_MAX_NODES][OPERATOR_ALPHABET];
+// token ending at a node, OPERATOR_NONE for inner nodes like ".."
+static uint8_t operator_type[OPERATOR_MAX_NODES];
+static pthread_once_t operator_table_once = PTHREAD_ONCE_INIT;
+
+static void operator_table_build(void) {
+    size_t node_count = 1;
+    size_t char_count = 1;
+    operator_type[0] = OPERATOR_NONE;
+
+    for (const Operator *op = operators; op->text != NULL; op++) {
+        size_t node = 0;
+
+        for (const char *p = op->text; *p; p++) {
+            unsigned char ch = *p;
+            if (operator_char[ch] == 0) {
+                if (char_count == OPERATOR_ALPHABET) {
+                    fprintf(stderr, "operator table alphabet is full at '%s'\n", op->text);
+                    abort();
+                }
+                operator_char[ch] = char_count++;
+            }
+
+            uint8_t *child = &operator_child[node][operator_char[ch]];
+            if (*child == 0) {
+                if (node_count == OPERATOR_MAX_NODES) {
+                    fprintf(stderr, "operator table is full at '%s'\n", op->text);
+                    abort();
+                }
+                operator_type[node_count] = OPERATOR_NONE;
+                *child = node_count++;
+            }
+            node = *child;
+        }
+
+        if (operator_type[node] != OPERATOR_NONE) {
+            fprintf(stderr, "operator '%s' is listed twice\n", op->text);
+            abort();
+        }
+        operator_type[node] = op->type;
+    }
+}
+
+// fills a static table, nothing is allocated. safe to call from any thread
+void operator_table_initialize(void) {
+    pthread_once(&operator_table_once, operator_table_build);
+}
+
+// length of the longest operator text starts with, 0 if none. at most
+// OPERATOR_MAX_LEN bytes are read and never more than length
+size_t operator_match(const char *text, size_t length, TokenType *type) {
+    size_t node = 0;
+    size_t matched = 0;
+
+    if (length > OPERATOR_MAX_LEN) length = OPERATOR_MAX_LEN;
+
+    for (size_t i = 0; i < length; i++) {
+        node = operator_child[node][operator_char[(unsigned char)text[i]]];
+        if (node == 0) break;
+
+        if (operator_type[node] != OPERATOR_NONE) {
+            *type = operator_type[node];
+            matched = i + 1;
+        }
+    }
+
+    return matched;
+}
@@ -0,0 +1,316 @@
+#include "parallel_lexer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// chunks start right after a newline and are lexed speculatively, as if
+// nothing was open at their start. a lexer is fully described by its
+// position, so once a sequential run from the
+// previous chunk starts a lexer_scan call at the same offset as the
+// speculative run did, every later speculative token is correct
+typedef struct {
+    size_t start, end;
+    Lexer lexer;
+    // bit i is set when token i was the first one of its lexer_scan call,
+    // those are the only points a re-lex can sync on
+    uint8_t *call_starts;
+    size_t call_starts_capacity;
+
+    // filled in while stitching
+    size_t keep_from;
+    // first byte of the chunk the speculative run is kept from
+    uint32_t keep_offset;
+    int has_fixup;
+    Lexer fixup;
+    // the fixup's tokens from this offset on were dropped at the sync
+    uint32_t fixup_end;
+    size_t out_index;
+} Chunk;
+
+typedef struct {
+    Lexer *lexer;
+    Chunk *chunk;
+} Chunk_job;
+
+static void set_call_start(Chunk *chunk, size_t index) {
+    size_t byte = index / 8;
+
+    if (byte >= chunk->call_starts_capacity) {
+        size_t capacity = chunk->call_starts_capacity ? chunk->call_starts_capacity * 2 : 4096;
+        while (capacity <= byte) capacity *= 2;
+
+        uint8_t *grown = realloc(chunk->call_starts, capacity);
+        if (!grown) {
+            perror("lexer_scan_parallel");
+            exit(EXIT_FAILURE);
+        }
+
+        memset(grown + chunk->call_starts_capacity, 0, capacity - chunk->call_starts_capacity);
+        chunk->call_starts = grown;
+        chunk->call_starts_capacity = capacity;
+    }
+
+    chunk->call_starts[byte] |= 1 << (index % 8);
+}
+
+static int is_call_start(Chunk *chunk, size_t index) {
+    size_t byte = index / 8;
+    return byte < chunk->call_starts_capacity && (chunk->call_starts[byte] >> (index % 8)) & 1;
+}
+
+static void scan_chunk(void *arg, int worker) {
+    (void)worker;
+    Chunk_job *job = arg;
+    Chunk *chunk = job->chunk;
+    Lexer *lexer = &chunk->lexer;
+
+    lexer_initialize(lexer);
+    lexer->source = job->lexer->source;
+    lexer->length = job->lexer->length;
+    lexer->position = chunk->start;
+    token_buffer_reserve(&lexer->tokens, (chunk->end - chunk->start) / 4);
+
+    // the last call may run past the end of the chunk, the next chunk
+    // notices that while stitching and re-lexes from there
+    while (lexer->position < chunk->end) {
+        size_t before = lexer->tokens.count;
+        if (lexer_scan(lexer) > 0) {
+            set_call_start(chunk, before);
+        }
+    }
+}
+
+// index of the speculative token starting at offset, or -1
+static long find_token(Chunk *chunk, uint32_t offset) {
+    Token_buffer *tokens = &chunk->lexer.tokens;
+    size_t low = 0, high = tokens->count;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (tokens->offsets[mid] < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low < tokens->count && tokens->offsets[low] == offset) return low;
+    return -1;
+}
+
+// re-lex sequentially from the state chunk k inherited until a call starts
+// where a speculative call also started. returns the chunk synced with,
+// or chunk_count if the re-lex ran to the end of the input
+static size_t relex_from(Lexer *lexer, Chunk *chunks, size_t chunk_count, size_t k,
+                         size_t position) {
+    Chunk *chunk = &chunks[k];
+    Lexer *fixup = &chunk->fixup;
+
+    lexer_initialize(fixup);
+    fixup->source = lexer->source;
+    fixup->length = lexer->length;
+    fixup->position = position;
+    chunk->has_fixup = 1;
+    chunk->fixup_end = UINT32_MAX;
+
+    size_t current = k;
+    while (fixup->position < fixup->length) {
+        size_t before = fixup->tokens.count;
+        int emitted = lexer_scan(fixup);
+        if (emitted == 0) continue;
+
+        uint32_t offset = fixup->tokens.offsets[before];
+        while (current < chunk_count && offset >= chunks[current].end) {
+            // skipped over entirely, nothing speculative survives
+            chunks[current].keep_from = chunks[current].lexer.tokens.count;
+            chunks[current].keep_offset = UINT32_MAX;
+            current++;
+        }
+
+        if (current == chunk_count) break;
+
+        long index = find_token(&chunks[current], offset);
+        if (index >= 0 && is_call_start(&chunks[current], index)) {
+            fixup->tokens.count = before;
+            chunk->fixup_end = offset;
+            chunks[current].keep_from = index;
+            chunks[current].keep_offset = offset;
+            return current;
+        }
+    }
+
+    for (; current < chunk_count; current++) {
+        chunks[current].keep_from = chunks[current].lexer.tokens.count;
+        chunks[current].keep_offset = UINT32_MAX;
+    }
+
+    return chunk_count;
+}
+
+static void copy_chunk(void *arg, int worker) {
+    (void)worker;
+    Chunk_job *job = arg;
+    Chunk *chunk = job->chunk;
+    Token_buffer *out = &job->lexer->tokens;
+    size_t index = chunk->out_index;
+
+    // a re-lex that ran into an unclosed comment may have no tokens and
+    // no arrays at all, same for a chunk that kept nothing
+    if (chunk->has_fixup && chunk->fixup.tokens.count > 0) {
+        Token_buffer *fixup = &chunk->fixup.tokens;
+        memcpy(out->types + index, fixup->types, fixup->count * sizeof(uint8_t));
+        memcpy(out->offsets + index, fixup->offsets, fixup->count * sizeof(uint32_t));
+        memcpy(out->lengths + index, fixup->lengths, fixup->count * sizeof(uint32_t));
+        memcpy(out->payloads + index, fixup->payloads, fixup->count * sizeof(uint32_t));
+        memcpy(out->values + index, fixup->values, fixup->count * sizeof(uint64_t));
+        index += fixup->count;
+    }
+
+    Token_buffer *tokens = &chunk->lexer.tokens;
+    size_t from = chunk->keep_from;
+    size_t count = tokens->count - from;
+
+    if (count > 0) {
+        memcpy(out->types + index, tokens->types + from, count * sizeof(uint8_t));
+        memcpy(out->offsets + index, tokens->offsets + from, count * sizeof(uint32_t));
+        memcpy(out->lengths + index, tokens->lengths + from, count * sizeof(uint32_t));
+        memcpy(out->payloads + index, tokens->payloads + from, count * sizeof(uint32_t));
+        memcpy(out->values + index, tokens->values + from, count * sizeof(uint64_t));
+    }
+
+    // only kept identifiers are interned, a chunk that started inside a
+    // comment or literal would otherwise add words that are no tokens
+    lexer_intern_tokens(job->lexer, chunk->out_index, index + count);
+}
+
+// a diagnostic is kept when its offset is in the part of a run that is
+// kept, the same bytes the kept tokens came from. line and col are filled
+// in once all are kept
+static void keep_diagnostics(Lexer *lexer, const Diagnostic_list *list, uint32_t from, uint32_t to) {
+    for (size_t i = 0; i < list->count; i++) {
+        const Diagnostic *diagnostic = &list->items[i];
+        if (diagnostic->offset < from || diagnostic->offset >= to) continue;
+
+        Diagnostic *kept = diagnostic_list_push(&lexer->diagnostics);
+        *kept = *diagnostic;
+    }
+}
+
+static size_t split_chunks(Lexer *lexer, Chunk *chunks, size_t wanted) {
+    size_t count = 0;
+    size_t start = lexer->position;
+    size_t span = lexer->length - start;
+
+    for (size_t i = 1; i <= wanted && start < lexer->length; i++) {
+        size_t end = lexer->length;
+
+        if (i < wanted) {
+            size_t target = lexer->position + span / wanted * i;
+            if (target < start) target = start;
+
+            const char *newline = memchr(lexer->source + target, '\n', lexer->length - target);
+            end = newline ? (size_t)(newline - lexer->source) + 1 : lexer->length;
+        }
+
+        memset(&chunks[count], 0, sizeof(Chunk));
+        chunks[count].start = start;
+        chunks[count].end = end;
+        chunks[count].keep_offset = start;
+        count++;
+        start = end;
+    }
+
+    return count;
+}
+
+// the lexer must be at the start of a line, normally a fresh source from
+// lexer_set_source. tokens are appended exactly as lexer_scan_all would
+size_t lexer_scan_parallel(Lexer *lexer, Thread_pool *pool, size_t min_chunk) {
+    size_t span = lexer->length - lexer->position;
+    size_t wanted = pool->worker_count * 4;
+    if (min_chunk > 0 && span / min_chunk < wanted) {
+        wanted = span / min_chunk;
+    }
+
+    if (wanted < 2) {
+        return lexer_scan_all(lexer);
+    }
+
+    Chunk *chunks = malloc(sizeof(Chunk) * wanted);
+    Chunk_job *jobs = malloc(sizeof(Chunk_job) * wanted);
+    if (!chunks || !jobs) {
+        perror("lexer_scan_parallel");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t chunk_count = split_chunks(lexer, chunks, wanted);
+
+    for (size_t i = 0; i < chunk_count; i++) {
+        jobs[i].lexer = lexer;
+        jobs[i].chunk = &chunks[i];
+        thread_pool_submit(pool, scan_chunk, &jobs[i]);
+    }
+    thread_pool_wait(pool);
+
+    // decide which speculative tokens survive, this only walks chunk
+    // boundaries unless a token or comment ran across one
+    size_t k = 0;
+    while (k < chunk_count) {
+        Chunk *chunk = &chunks[k];
+        Lexer *speculative = &chunk->lexer;
+
+        if (speculative->position == chunk->end || k + 1 == chunk_count) {
+            k++;
+            continue;
+        }
+
+        k = relex_from(lexer, chunks, chunk_count, k + 1, speculative->position);
+        if (k < chunk_count) {
+            // the synced chunk's own end state is now the sequential one,
+            // look at it again on the next iteration
+            continue;
+        }
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < chunk_count; i++) {
+        chunks[i].out_index = lexer->tokens.count + total;
+        if (chunks[i].has_fixup) total += chunks[i].fixup.tokens.count;
+        total += chunks[i].lexer.tokens.count - chunks[i].keep_from;
+    }
+
+    if (token_buffer_reserve(&lexer->tokens, lexer->tokens.count + total) < 0) {
+        perror("lexer_scan_parallel");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < chunk_count; i++) {
+        thread_pool_submit(pool, copy_chunk, &jobs[i]);
+    }
+    thread_pool_wait(pool);
+
+    lexer->tokens.count += total;
+    lexer->position = lexer->length;
+
+    for (size_t i = 0; i < chunk_count; i++) {
+        Chunk *chunk = &chunks[i];
+        if (chunk->has_fixup) {
+            keep_diagnostics(lexer, &chunk->fixup.diagnostics, 0, chunk->fixup_end);
+        }
+
+        keep_diagnostics(lexer, &chunk->lexer.diagnostics, chunk->keep_offset, UINT32_MAX);
+    }
+    lexer_locate_diagnostics(lexer);
+
+    for (size_t i = 0; i < chunk_count; i++) {
+        lexer_cleanup(&chunks[i].lexer);
+        if (chunks[i].has_fixup) lexer_cleanup(&chunks[i].fixup);
+        free(chunks[i].call_starts);
+    }
+
+    free(chunks);
+    free(jobs);
+
+    return total;
+}
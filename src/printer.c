@@ -0,0 +1,333 @@
+#include "printer.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define PRINTER_BUFFER_SIZE (1024 * 1024)
+
+// the fixed part of a record, names, numbers and escapes around the text
+#define PRINTER_RECORD_SLACK 256
+
+#define COLOR_TEXT "\x1B[34m"
+#define COLOR_RESET "\x1B[37m"
+
+void printer_initialize(Printer *printer, FILE *out, Print_format format, int color) {
+    printer->out = out;
+    printer->format = format;
+    printer->color = color;
+    printer->symbols = 0;
+    printer->buffer = NULL;
+    printer->used = 0;
+    printer->capacity = 0;
+    printer->chars_printed = 0;
+
+    for (int type = 0; type <= TOKEN_EOF; type++) {
+        printer->names[type] = get_token_name(type);
+        printer->name_lengths[type] = strlen(printer->names[type]);
+    }
+}
+
+void printer_flush(Printer *printer) {
+    if (printer->out && printer->used > 0) {
+        fwrite(printer->buffer, 1, printer->used, printer->out);
+        printer->used = 0;
+    }
+}
+
+void printer_clear(Printer *printer) { printer->used = 0; }
+
+// room for size more bytes. only a collecting printer or a token longer
+// than the buffer makes it grow, otherwise the buffer is flushed
+static char *printer_reserve(Printer *printer, size_t size) {
+    if (printer->capacity - printer->used < size) {
+        printer_flush(printer);
+    }
+
+    if (printer->capacity - printer->used < size) {
+        size_t capacity = printer->capacity ? printer->capacity * 2 : PRINTER_BUFFER_SIZE;
+        while (capacity - printer->used < size) capacity *= 2;
+
+        char *grown = realloc(printer->buffer, capacity);
+        if (!grown) {
+            perror("printer");
+            exit(EXIT_FAILURE);
+        }
+        printer->buffer = grown;
+        printer->capacity = capacity;
+    }
+
+    return printer->buffer + printer->used;
+}
+
+static inline char *put(char *cursor, const char *text, size_t length) {
+    memcpy(cursor, text, length);
+    return cursor + length;
+}
+
+#define PUT_LITERAL(cursor, text) put(cursor, text, sizeof(text) - 1)
+
+static inline int count_digits(uint32_t value) {
+    int digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+static inline char *put_uint(char *cursor, uint32_t value) {
+    int digits = count_digits(value);
+    char *end = cursor + digits;
+
+    do {
+        *--end = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    return cursor + digits;
+}
+
+static inline char *put_spaces(char *cursor, int count) {
+    memset(cursor, ' ', count);
+    return cursor + count;
+}
+
+// NAME 'text' Ln line, Col col with the text in blue on a terminal
+static char *put_pretty(Printer *printer, char *cursor, Lexer *lexer, const Token *token,
+                        Source_position position) {
+    cursor = put(cursor, printer->names[token->type], printer->name_lengths[token->type]);
+    if (printer->color) {
+        cursor = PUT_LITERAL(cursor, " " COLOR_TEXT "'");
+    }
+    else {
+        cursor = PUT_LITERAL(cursor, " '");
+    }
+
+    cursor = put(cursor, token_text(lexer, token), token->length);
+    if (printer->color) {
+        cursor = PUT_LITERAL(cursor, "'" COLOR_RESET " Ln ");
+    }
+    else {
+        cursor = PUT_LITERAL(cursor, "' Ln ");
+    }
+
+    cursor = put_uint(cursor, position.line);
+    cursor = PUT_LITERAL(cursor, ", Col ");
+    return put_uint(cursor, position.col);
+}
+
+// tokens are laid out in columns 50 or 100 characters wide, a token
+// that does not fit in 100 gets a row of its own
+static void print_pretty(Printer *printer, Lexer *lexer, const Token *token, Source_position position) {
+    int first_break_point = 50;
+    int second_break_point = 100;
+
+    // the visible width, escape codes are not counted
+    int total_len = printer->name_lengths[token->type] + token->length + count_digits(position.line) +
+                    count_digits(position.col) + 14;
+
+    char *cursor = printer_reserve(printer, token->length + second_break_point + PRINTER_RECORD_SLACK);
+
+    if (total_len <= second_break_point) {
+        int width = total_len < first_break_point ? first_break_point : second_break_point;
+        printer->chars_printed += width;
+
+        cursor = put_pretty(printer, cursor, lexer, token, position);
+        cursor = put_spaces(cursor, width - total_len);
+    }
+    else {
+        if (printer->chars_printed > 0) {
+            *cursor++ = '\n';
+            cursor = put_pretty(printer, cursor, lexer, token, position);
+            *cursor++ = '\n';
+        }
+        else {
+            cursor = put_pretty(printer, cursor, lexer, token, position);
+        }
+
+        printer->chars_printed = 0;
+    }
+
+    if (printer->chars_printed > second_break_point) {
+        printer->chars_printed = 0;
+        *cursor++ = '\n';
+    }
+
+    printer->used = cursor - printer->buffer;
+}
+
+// tokens never hold a newline, but a literal may hold tabs
+static char *put_tsv_text(char *cursor, const char *text, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        char ch = text[i];
+        if (ch == '\t' || ch == '\\' || ch == '\r') {
+            *cursor++ = '\\';
+            *cursor++ = ch == '\t' ? 't' : ch == '\r' ? 'r' : '\\';
+        }
+        else {
+            *cursor++ = ch;
+        }
+    }
+    return cursor;
+}
+
+static void print_tsv(Printer *printer, Lexer *lexer, const Token *token, Source_position position) {
+    char *cursor = printer_reserve(printer, 2 * token->length + PRINTER_RECORD_SLACK);
+
+    cursor = put(cursor, printer->names[token->type], printer->name_lengths[token->type]);
+    *cursor++ = '\t';
+    cursor = put_tsv_text(cursor, token_text(lexer, token), token->length);
+    *cursor++ = '\t';
+    cursor = put_uint(cursor, position.line);
+    *cursor++ = '\t';
+    cursor = put_uint(cursor, position.col);
+    *cursor++ = '\n';
+
+    printer->used = cursor - printer->buffer;
+}
+
+// length of the well formed UTF-8 sequence (RFC 3629) starting at text,
+// 0 if there is none: a stray continuation byte, a truncated sequence, an
+// overlong form, a surrogate or a code point past U+10FFFF
+static size_t utf8_sequence(const unsigned char *text, size_t length) {
+    unsigned char lead = text[0];
+    size_t size;
+    unsigned char low = 0x80, high = 0xbf;
+
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        size = 2;
+    }
+    else if (lead >= 0xe0 && lead <= 0xef) {
+        size = 3;
+        if (lead == 0xe0) low = 0xa0;
+        if (lead == 0xed) high = 0x9f;
+    }
+    else if (lead >= 0xf0 && lead <= 0xf4) {
+        size = 4;
+        if (lead == 0xf0) low = 0x90;
+        if (lead == 0xf4) high = 0x8f;
+    }
+    else {
+        return 0;
+    }
+
+    if (size > length || text[1] < low || text[1] > high) return 0;
+    for (size_t i = 2; i < size; i++) {
+        if (text[i] < 0x80 || text[i] > 0xbf) return 0;
+    }
+    return size;
+}
+
+// UTF-8 text is written as is. control characters and DEL are escaped, a
+// byte that is not part of well formed UTF-8 (stray bytes come out as
+// TOKEN_INVALID) becomes U+FFFD, so every line is valid JSON
+static char *put_json_text(char *cursor, const char *text, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+
+    for (size_t i = 0; i < length; i++) {
+        unsigned char ch = text[i];
+        if (ch == '"' || ch == '\\') {
+            *cursor++ = '\\';
+            *cursor++ = ch;
+        }
+        else if (ch < 0x20 || ch == 0x7f) {
+            cursor = PUT_LITERAL(cursor, "\\u00");
+            *cursor++ = hex[ch >> 4];
+            *cursor++ = hex[ch & 15];
+        }
+        else if (ch > 0x7f) {
+            size_t size = utf8_sequence((const unsigned char *)text + i, length - i);
+            if (size == 0) {
+                cursor = PUT_LITERAL(cursor, "\\ufffd");
+            }
+            else {
+                cursor = put(cursor, text + i, size);
+                i += size - 1;
+            }
+        }
+        else {
+            *cursor++ = ch;
+        }
+    }
+    return cursor;
+}
+
+static void print_jsonl(Printer *printer, Lexer *lexer, const Token *token, Source_position position) {
+    char *cursor = printer_reserve(printer, 6 * token->length + PRINTER_RECORD_SLACK);
+
+    cursor = PUT_LITERAL(cursor, "{\"type\":\"");
+    cursor = put(cursor, printer->names[token->type], printer->name_lengths[token->type]);
+    cursor = PUT_LITERAL(cursor, "\",\"text\":\"");
+    cursor = put_json_text(cursor, token_text(lexer, token), token->length);
+    cursor = PUT_LITERAL(cursor, "\",\"line\":");
+    cursor = put_uint(cursor, position.line);
+    cursor = PUT_LITERAL(cursor, ",\"col\":");
+    cursor = put_uint(cursor, position.col);
+    cursor = PUT_LITERAL(cursor, ",\"offset\":");
+    cursor = put_uint(cursor, token->offset);
+    cursor = PUT_LITERAL(cursor, ",\"length\":");
+    cursor = put_uint(cursor, token->length);
+    if (printer->symbols && token->type == TOKEN_IDENTIFIER) {
+        cursor = PUT_LITERAL(cursor, ",\"symbol\":");
+        cursor = put_uint(cursor, token->payload);
+    }
+    cursor = PUT_LITERAL(cursor, "}\n");
+
+    printer->used = cursor - printer->buffer;
+}
+
+// the token's line and col are looked up here, tokens come in source
+// order so the line index mostly answers from its hint
+void printer_token(Printer *printer, Lexer *lexer, const Token *token) {
+    Source_position position = lexer_position(lexer, token->offset);
+
+    switch (printer->format) {
+        case PRINT_PRETTY:
+            print_pretty(printer, lexer, token, position);
+            break;
+
+        case PRINT_TSV:
+            print_tsv(printer, lexer, token, position);
+            break;
+
+        case PRINT_JSONL:
+            print_jsonl(printer, lexer, token, position);
+            break;
+    }
+}
+
+void printer_tokens(Printer *printer, Lexer *lexer) {
+    Token_iter iter;
+    token_iter_initialize(&iter, lexer);
+    Token token;
+
+    while (token_iter_next(&iter, &token)) {
+        printer_token(printer, lexer, &token);
+    }
+}
+
+// ends one token stream, the pretty layout closes its last row
+void printer_end(Printer *printer) {
+    if (printer->format == PRINT_PRETTY) {
+        char *cursor = printer_reserve(printer, 1);
+        *cursor = '\n';
+        printer->used++;
+    }
+    printer->chars_printed = 0;
+}
+
+void printer_free(Printer *printer) {
+    printer_flush(printer);
+    free(printer->buffer);
+    printer->buffer = NULL;
+    printer->used = printer->capacity = 0;
+}
+
+// the whole stream in the original layout, colored if out is a terminal
+void print_tokens(Lexer *lexer, FILE *out) {
+    Printer printer;
+    printer_initialize(&printer, out, PRINT_PRETTY, isatty(fileno(out)));
+    printer_tokens(&printer, lexer);
+    printer_end(&printer);
+    printer_free(&printer);
+}
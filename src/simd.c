@@ -0,0 +1,283 @@
+#include "simd.h"
+#include "char_class.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#endif
+
+static size_t scalar_run(const char *data, size_t length, uint16_t mask) {
+    size_t i = 0;
+    while (i < length && char_is(data[i], mask)) {
+        i++;
+    }
+    return i;
+}
+
+static size_t scalar_space(const char *data, size_t length) {
+    return scalar_run(data, length, CHAR_SPACE);
+}
+
+static size_t scalar_ident(const char *data, size_t length) {
+    return scalar_run(data, length, CHAR_IDENT);
+}
+
+static size_t scalar_comment(const char *data, size_t length) {
+    return scalar_run(data, length, CHAR_COMMENT);
+}
+
+static size_t scalar_block_comment(const char *data, size_t length) {
+    const char *star = data;
+    const char *end = data + length;
+
+    while ((star = memchr(star, '*', end - star)) != NULL) {
+        if (star + 1 < end && star[1] == '/') return star + 2 - data;
+        star++;
+    }
+    return length;
+}
+
+static size_t scalar_lines(const char *data, size_t length, uint32_t base, uint32_t *starts) {
+    size_t count = 0;
+    const char *newline = data;
+    const char *end = data + length;
+
+    while ((newline = memchr(newline, '\n', end - newline)) != NULL) {
+        newline++;
+        starts[count++] = base + (uint32_t)(newline - data);
+    }
+    return count;
+}
+
+#ifdef SIMD_X86
+
+// the masks below must agree with char_class.c:
+//   space   ' ' and 0x09..0x0d except '\n'
+//   ident   a-z, A-Z, 0-9 and _
+//   comment everything but '\n', NUL and 0xff
+// x86 only has signed byte compares, so "lo <= x <= hi" is done as
+// min_epu8(x - lo, hi - lo) == x - lo
+
+__attribute__((target("sse2")))
+static inline __m128i sse2_in_range(__m128i v, char lo, char hi) {
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(hi - lo)), shifted);
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_space(const char *data, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                     sse2_in_range(v, '\t', '\r'));
+        blank = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), blank);
+
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(blank) & 0xffff;
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + scalar_space(data + i, length - i);
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_ident(const char *data, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        // setting bit 5 folds A-Z onto a-z and moves no other byte into a-z
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i ident = _mm_or_si128(sse2_in_range(lower, 'a', 'z'), sse2_in_range(v, '0', '9'));
+        ident = _mm_or_si128(ident, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(ident) & 0xffff;
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + scalar_ident(data + i, length - i);
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_comment(const char *data, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i end = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                   _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+        end = _mm_or_si128(end, _mm_cmpeq_epi8(v, _mm_set1_epi8((char)0xff)));
+
+        unsigned stop = (unsigned)_mm_movemask_epi8(end);
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + scalar_comment(data + i, length - i);
+}
+
+// a '*' whose next byte is '/' ends the comment, so every block is
+// compared once as is and once shifted by a byte
+__attribute__((target("sse2")))
+static size_t sse2_block_comment(const char *data, size_t length) {
+    size_t i = 0;
+    for (; i + 17 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i next = _mm_loadu_si128((const __m128i *)(data + i + 1));
+        unsigned end = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('*'))) &
+                       (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(next, _mm_set1_epi8('/')));
+
+        if (end) return i + __builtin_ctz(end) + 2;
+    }
+    return i + scalar_block_comment(data + i, length - i);
+}
+
+// every set bit of a block's newline mask is one line start
+__attribute__((target("sse2")))
+static size_t sse2_lines(const char *data, size_t length, uint32_t base, uint32_t *starts) {
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        unsigned lines = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+
+        while (lines) {
+            starts[count++] = base + (uint32_t)(i + __builtin_ctz(lines) + 1);
+            lines &= lines - 1;
+        }
+    }
+    return count + scalar_lines(data + i, length - i, base + (uint32_t)i, starts + count);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_in_range(__m256i v, char lo, char hi) {
+    __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(hi - lo)), shifted);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_space(const char *data, size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                        avx2_in_range(v, '\t', '\r'));
+        blank = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), blank);
+
+        uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(blank);
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + sse2_space(data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_ident(const char *data, size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i ident = _mm256_or_si256(avx2_in_range(lower, 'a', 'z'), avx2_in_range(v, '0', '9'));
+        ident = _mm256_or_si256(ident, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+
+        uint32_t stop = ~(uint32_t)_mm256_movemask_epi8(ident);
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + sse2_ident(data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_comment(const char *data, size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i end = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                                      _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+        end = _mm256_or_si256(end, _mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)0xff)));
+
+        uint32_t stop = (uint32_t)_mm256_movemask_epi8(end);
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + sse2_comment(data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_block_comment(const char *data, size_t length) {
+    size_t i = 0;
+    for (; i + 33 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i next = _mm256_loadu_si256((const __m256i *)(data + i + 1));
+        uint32_t end = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('*'))) &
+                       (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(next, _mm256_set1_epi8('/')));
+
+        if (end) return i + __builtin_ctz(end) + 2;
+    }
+    return i + sse2_block_comment(data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_lines(const char *data, size_t length, uint32_t base, uint32_t *starts) {
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        uint32_t lines = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+
+        while (lines) {
+            starts[count++] = base + (uint32_t)(i + __builtin_ctz(lines) + 1);
+            lines &= lines - 1;
+        }
+    }
+    return count + sse2_lines(data + i, length - i, base + (uint32_t)i, starts + count);
+}
+
+#endif
+
+static const Simd_kernels scalar_kernels = {
+    scalar_space, scalar_ident, scalar_comment, scalar_block_comment, scalar_lines, "scalar",
+};
+#ifdef SIMD_X86
+static const Simd_kernels sse2_kernels = {
+    sse2_space, sse2_ident, sse2_comment, sse2_block_comment, sse2_lines, "sse2",
+};
+static const Simd_kernels avx2_kernels = {
+    avx2_space, avx2_ident, avx2_comment, avx2_block_comment, avx2_lines, "avx2",
+};
+#endif
+
+Simd_kernels simd = { scalar_space, scalar_ident, scalar_comment, scalar_block_comment, scalar_lines, "scalar" };
+static pthread_once_t simd_once = PTHREAD_ONCE_INIT;
+
+static void simd_select(void) {
+    const char *wanted = getenv("LEXER_SIMD");
+
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    int has_sse2 = __builtin_cpu_supports("sse2");
+    int has_avx2 = __builtin_cpu_supports("avx2");
+
+    if (wanted == NULL) {
+        if (has_avx2) simd = avx2_kernels;
+        else if (has_sse2) simd = sse2_kernels;
+        return;
+    }
+
+    if (strcmp(wanted, "avx2") == 0 && has_avx2) {
+        simd = avx2_kernels;
+        return;
+    }
+    if (strcmp(wanted, "sse2") == 0 && has_sse2) {
+        simd = sse2_kernels;
+        return;
+    }
+#endif
+
+    if (wanted != NULL && strcmp(wanted, "scalar") != 0) {
+        fprintf(stderr, "LEXER_SIMD=%s is not supported here, using scalar\n", wanted);
+    }
+    simd = scalar_kernels;
+}
+
+// safe to call from any thread, the kernels are chosen only once
+void simd_initialize(void) {
+    pthread_once(&simd_once, simd_select);
+}
@@ -0,0 +1,147 @@
+#include "stats.h"
+
+#ifdef LEXER_STATS
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+__thread Lexer_stats *stats_local;
+
+// every thread's block stays on this list until exit, blocks are never
+// freed so a summary can still be printed after the workers are gone
+static Lexer_stats *stats_list;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// ticks are converted to time by comparing them with the wall clock
+// over the whole run
+static uint64_t calibration_ticks;
+static double calibration_seconds;
+
+static double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+Lexer_stats *stats_register(void) {
+    Lexer_stats *stats = calloc(1, sizeof(Lexer_stats));
+    if (!stats) {
+        perror("stats_register");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_lock(&stats_lock);
+    if (stats_list == NULL) {
+        calibration_ticks = stats_clock();
+        calibration_seconds = wall_seconds();
+    }
+    stats->next = stats_list;
+    stats_list = stats;
+    pthread_mutex_unlock(&stats_lock);
+
+    stats_local = stats;
+    return stats;
+}
+
+static const char *phase_names[STAT_PHASE_COUNT] = {
+    [STAT_IO] = "io",
+    [STAT_WHITESPACE] = "whitespace",
+    [STAT_IDENTIFIER] = "identifier",
+    [STAT_KEYWORD] = "keyword",
+    [STAT_INTERN] = "intern",
+    [STAT_NUMBER] = "number",
+    [STAT_LITERAL] = "literal",
+    [STAT_COMMENT] = "comment",
+    [STAT_CREATE_TOKEN] = "create_token",
+    [STAT_LINES] = "lines",
+};
+
+int stats_enabled(void) { return 1; }
+
+// phase times are summed over threads, seconds is the wall time of the
+// run and only used for the throughput figures
+void stats_print(FILE *out, int json, double seconds) {
+    Lexer_stats total;
+    memset(&total, 0, sizeof total);
+
+    pthread_mutex_lock(&stats_lock);
+    for (Lexer_stats *stats = stats_list; stats; stats = stats->next) {
+        for (int i = 0; i < STAT_PHASE_COUNT; i++) {
+            total.ticks[i] += stats->ticks[i];
+            total.calls[i] += stats->calls[i];
+        }
+        for (int i = 0; i <= TOKEN_EOF; i++) {
+            total.tokens[i] += stats->tokens[i];
+        }
+        total.bytes += stats->bytes;
+        total.allocations += stats->allocations;
+        total.allocated_bytes += stats->allocated_bytes;
+    }
+    pthread_mutex_unlock(&stats_lock);
+
+    double elapsed = wall_seconds() - calibration_seconds;
+    uint64_t ticks = stats_clock() - calibration_ticks;
+    double ns_per_tick = ticks > 0 && elapsed > 0 ? elapsed * 1e9 / ticks : 0;
+
+    uint64_t token_count = 0;
+    for (int i = 0; i <= TOKEN_EOF; i++) token_count += total.tokens[i];
+
+    double mb = total.bytes / 1e6;
+    double mb_per_second = seconds > 0 ? mb / seconds : 0;
+    double tokens_per_second = seconds > 0 ? token_count / seconds : 0;
+
+    if (json) {
+        fprintf(out, "{\"seconds\": %.6f, \"bytes\": %llu, \"mb_per_second\": %.2f, \"tokens\": %llu, "
+                     "\"tokens_per_second\": %.0f, \"allocations\": %llu, \"allocated_bytes\": %llu, \"phases\": {",
+                seconds, (unsigned long long)total.bytes, mb_per_second, (unsigned long long)token_count,
+                tokens_per_second, (unsigned long long)total.allocations,
+                (unsigned long long)total.allocated_bytes);
+
+        for (int i = 0; i < STAT_PHASE_COUNT; i++) {
+            fprintf(out, "%s\"%s\": {\"calls\": %llu, \"ns\": %.0f}", i ? ", " : "", phase_names[i],
+                    (unsigned long long)total.calls[i], total.ticks[i] * ns_per_tick);
+        }
+
+        fprintf(out, "}, \"token_types\": {");
+        int first = 1;
+        for (int i = 0; i <= TOKEN_EOF; i++) {
+            if (total.tokens[i] == 0) continue;
+            fprintf(out, "%s\"%s\": %llu", first ? "" : ", ", get_token_name(i), (unsigned long long)total.tokens[i]);
+            first = 0;
+        }
+        fprintf(out, "}}\n");
+        return;
+    }
+
+    fprintf(out, "%.2f MB, %llu tokens in %.3fs (%.1f MB/s, %.2f Mtokens/s)\n", mb,
+            (unsigned long long)token_count, seconds, mb_per_second, tokens_per_second / 1e6);
+    fprintf(out, "%llu allocations, %.2f MB\n\n", (unsigned long long)total.allocations,
+            total.allocated_bytes / 1e6);
+
+    fprintf(out, "%-14s %12s %12s %10s\n", "phase", "calls", "ms", "ns/call");
+    for (int i = 0; i < STAT_PHASE_COUNT; i++) {
+        double ns = total.ticks[i] * ns_per_tick;
+        fprintf(out, "%-14s %12llu %12.2f %10.1f\n", phase_names[i], (unsigned long long)total.calls[i],
+                ns / 1e6, total.calls[i] ? ns / total.calls[i] : 0);
+    }
+
+    fprintf(out, "\n%-26s %12s\n", "token type", "count");
+    for (int i = 0; i <= TOKEN_EOF; i++) {
+        if (total.tokens[i] == 0) continue;
+        fprintf(out, "%-26s %12llu\n", get_token_name(i), (unsigned long long)total.tokens[i]);
+    }
+}
+
+#else
+
+int stats_enabled(void) { return 0; }
+
+void stats_print(FILE *out, int json, double seconds) {
+    (void)json;
+    (void)seconds;
+    fprintf(out, "built without LEXER_STATS, rebuild with make STATS=1\n");
+}
+
+#endif
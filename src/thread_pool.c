@@ -0,0 +1,215 @@
+#include "thread_pool.h"
+
+#include <stdio.h>
+
+#define DEQUE_MIN_CAPACITY 64
+
+typedef struct {
+    Thread_pool *pool;
+    int id;
+} Worker_arg;
+
+// index of the worker running on this thread, -1 outside the pool
+static __thread int current_worker = -1;
+
+int thread_pool_worker_id(void) { return current_worker; }
+
+static void deque_initialize(Task_deque *deque) {
+    pthread_mutex_init(&deque->lock, NULL);
+    deque->tasks = NULL;
+    deque->top = 0;
+    deque->bottom = 0;
+    deque->capacity = 0;
+}
+
+// top and bottom only ever grow, slots are taken modulo capacity
+static void deque_push(Task_deque *deque, Task task) {
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->bottom - deque->top == deque->capacity) {
+        size_t capacity = deque->capacity ? deque->capacity * 2 : DEQUE_MIN_CAPACITY;
+        Task *tasks = malloc(sizeof(Task) * capacity);
+        if (!tasks) {
+            perror("thread_pool_submit");
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t i = deque->top; i < deque->bottom; i++) {
+            tasks[i % capacity] = deque->tasks[i % deque->capacity];
+        }
+
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->capacity = capacity;
+    }
+
+    deque->tasks[deque->bottom % deque->capacity] = task;
+    deque->bottom++;
+
+    pthread_mutex_unlock(&deque->lock);
+}
+
+static int deque_pop(Task_deque *deque, Task *task) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->bottom > deque->top) {
+        deque->bottom--;
+        *task = deque->tasks[deque->bottom % deque->capacity];
+        found = 1;
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static int deque_steal(Task_deque *deque, Task *task) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->bottom > deque->top) {
+        *task = deque->tasks[deque->top % deque->capacity];
+        deque->top++;
+        found = 1;
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static int find_task(Thread_pool *pool, int id, Task *task) {
+    if (deque_pop(&pool->deques[id], task)) return 1;
+
+    // start with the neighbour so thieves dont all hit worker 0
+    for (int i = 1; i < pool->worker_count; i++) {
+        int victim = (id + i) % pool->worker_count;
+        if (deque_steal(&pool->deques[victim], task)) return 1;
+    }
+
+    return 0;
+}
+
+static void *worker_main(void *arg) {
+    Worker_arg *worker = arg;
+    Thread_pool *pool = worker->pool;
+    int id = worker->id;
+    free(worker);
+
+    current_worker = id;
+
+    while (1) {
+        Task task;
+        if (find_task(pool, id, &task)) {
+            pthread_mutex_lock(&pool->lock);
+            pool->queued--;
+            pthread_mutex_unlock(&pool->lock);
+
+            task.fn(task.arg, id);
+
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->pending == 0) {
+                pthread_cond_broadcast(&pool->all_done);
+            }
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !pool->shutdown) {
+            pthread_cond_wait(&pool->work_available, &pool->lock);
+        }
+
+        int shutdown = pool->shutdown && pool->queued == 0;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (shutdown) break;
+    }
+
+    return NULL;
+}
+
+int thread_pool_initialize(Thread_pool *pool, int worker_count) {
+    if (worker_count < 1) worker_count = 1;
+
+    pool->worker_count = worker_count;
+    pool->pending = 0;
+    pool->queued = 0;
+    pool->shutdown = 0;
+    pool->next_deque = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_available, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+
+    pool->threads = malloc(sizeof(pthread_t) * worker_count);
+    pool->deques = malloc(sizeof(Task_deque) * worker_count);
+    if (!pool->threads || !pool->deques) return -1;
+
+    for (int i = 0; i < worker_count; i++) {
+        deque_initialize(&pool->deques[i]);
+    }
+
+    for (int i = 0; i < worker_count; i++) {
+        Worker_arg *arg = malloc(sizeof(Worker_arg));
+        if (!arg) return -1;
+
+        arg->pool = pool;
+        arg->id = i;
+        if (pthread_create(&pool->threads[i], NULL, worker_main, arg) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// tasks submitted from inside a worker go to its own deque so nested work
+// stays local until someone steals it, outside submissions are spread
+// round robin
+void thread_pool_submit(Thread_pool *pool, Task_fn fn, void *arg) {
+    Task task = { fn, arg };
+
+    // counted before the push so a worker that grabs the task early can
+    // never take queued below zero, at worst an idle worker retries once
+    pthread_mutex_lock(&pool->lock);
+    pool->pending++;
+    pool->queued++;
+    size_t target = current_worker >= 0 ? (size_t)current_worker
+                                        : pool->next_deque++ % pool->worker_count;
+    pthread_mutex_unlock(&pool->lock);
+
+    deque_push(&pool->deques[target], task);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work_available);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_wait(Thread_pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_destroy(Thread_pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_available);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    for (int i = 0; i < pool->worker_count; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+
+    free(pool->threads);
+    free(pool->deques);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_available);
+    pthread_cond_destroy(&pool->all_done);
+}
@@ -0,0 +1,105 @@
+#include "token_buffer.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TOKEN_BUFFER_MIN_CAPACITY 1024
+
+// resize one column, on failure the old array is left untouched
+static int grow_array(void **array, size_t element_size, size_t capacity) {
+    void *grown = realloc(*array, element_size * capacity);
+    if (!grown) return -1;
+    STATS_ALLOC(element_size * capacity);
+
+    *array = grown;
+    return 0;
+}
+
+void token_buffer_initialize(Token_buffer *buffer) {
+    buffer->types = NULL;
+    buffer->offsets = NULL;
+    buffer->lengths = NULL;
+    buffer->payloads = NULL;
+    buffer->values = NULL;
+    buffer->count = 0;
+    buffer->capacity = 0;
+}
+
+int token_buffer_reserve(Token_buffer *buffer, size_t capacity) {
+    if (capacity <= buffer->capacity) return 0;
+
+    if (grow_array((void **)&buffer->types, sizeof(uint8_t), capacity) < 0 ||
+        grow_array((void **)&buffer->offsets, sizeof(uint32_t), capacity) < 0 ||
+        grow_array((void **)&buffer->lengths, sizeof(uint32_t), capacity) < 0 ||
+        grow_array((void **)&buffer->payloads, sizeof(uint32_t), capacity) < 0 ||
+        grow_array((void **)&buffer->values, sizeof(uint64_t), capacity) < 0) {
+        return -1;
+    }
+
+    buffer->capacity = capacity;
+    return 0;
+}
+
+size_t token_buffer_push(Token_buffer *buffer, uint8_t type, uint32_t offset, uint32_t length) {
+    if (buffer->count == buffer->capacity) {
+        size_t capacity = buffer->capacity * 2;
+        if (capacity < TOKEN_BUFFER_MIN_CAPACITY) capacity = TOKEN_BUFFER_MIN_CAPACITY;
+
+        if (token_buffer_reserve(buffer, capacity) < 0) {
+            perror("token_buffer_push");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    size_t index = buffer->count++;
+    buffer->types[index] = type;
+    buffer->offsets[index] = offset;
+    buffer->lengths[index] = length;
+    buffer->payloads[index] = 0;
+    buffer->values[index] = 0;
+    return index;
+}
+
+// move one column's tail and copy the new rows in front of it. an empty
+// source or buffer may have no arrays yet, nothing is copied from those
+#define SPLICE_COLUMN(column)                                                                 \
+    do {                                                                                      \
+        if (tail > 0) {                                                                       \
+            memmove(buffer->column + index + source->count, buffer->column + index + removed, \
+                    tail * sizeof(*buffer->column));                                          \
+        }                                                                                     \
+        if (source->count > 0) {                                                              \
+            memcpy(buffer->column + index, source->column,                                    \
+                   source->count * sizeof(*buffer->column));                                  \
+        }                                                                                     \
+    } while (0)
+
+// replace the rows [index, index + removed) with all rows of source. the
+// rows after them keep their values, callers shift them if needed
+int token_buffer_splice(Token_buffer *buffer, size_t index, size_t removed, const Token_buffer *source) {
+    size_t count = buffer->count - removed + source->count;
+    if (token_buffer_reserve(buffer, count) < 0) return -1;
+
+    size_t tail = buffer->count - index - removed;
+    SPLICE_COLUMN(types);
+    SPLICE_COLUMN(offsets);
+    SPLICE_COLUMN(lengths);
+    SPLICE_COLUMN(payloads);
+    SPLICE_COLUMN(values);
+
+    buffer->count = count;
+    return 0;
+}
+
+// forget the tokens but keep the arrays for the next run
+void token_buffer_clear(Token_buffer *buffer) { buffer->count = 0; }
+
+void token_buffer_free(Token_buffer *buffer) {
+    free(buffer->types);
+    free(buffer->offsets);
+    free(buffer->lengths);
+    free(buffer->payloads);
+    free(buffer->values);
+    token_buffer_initialize(buffer);
+}
@@ -0,0 +1,270 @@
+#include "token_cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TOKEN_CACHE_SEED (((uint64_t)LEXER_VERSION << 32) | TOKEN_FILE_VERSION)
+
+// left behind by a run that died between creating and renaming an entry
+#define TOKEN_CACHE_STALE_SECONDS 3600
+
+static const uint64_t hash_secret[4] = {
+    0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+    0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull,
+};
+
+static inline uint64_t read64(const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof value);
+    return value;
+}
+
+static inline uint64_t read32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof value);
+    return value;
+}
+
+// 64x64 to 128 bit multiply, the low and high halves replace a and b
+static inline void hash_multiply(uint64_t *a, uint64_t *b) {
+    __uint128_t product = (__uint128_t)*a * *b;
+    *a = (uint64_t)product;
+    *b = (uint64_t)(product >> 64);
+}
+
+static inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+    hash_multiply(&a, &b);
+    return a ^ b;
+}
+
+// wyhash: three independent multiply lanes over 48 byte blocks, several
+// GB/s so hashing a file costs a fraction of lexing it
+uint64_t token_cache_hash(const void *data, size_t length, uint64_t seed) {
+    const uint8_t *p = data;
+    uint64_t a, b;
+
+    seed ^= hash_mix(seed ^ hash_secret[0], hash_secret[1]);
+
+    if (length <= 16) {
+        if (length >= 4) {
+            size_t middle = (length >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + middle);
+            b = (read32(p + length - 4) << 32) | read32(p + length - 4 - middle);
+        }
+        else if (length > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+            b = 0;
+        }
+        else {
+            a = b = 0;
+        }
+    }
+    else {
+        size_t left = length;
+        if (left > 48) {
+            uint64_t lane1 = seed, lane2 = seed;
+            do {
+                seed = hash_mix(read64(p) ^ hash_secret[1], read64(p + 8) ^ seed);
+                lane1 = hash_mix(read64(p + 16) ^ hash_secret[2], read64(p + 24) ^ lane1);
+                lane2 = hash_mix(read64(p + 32) ^ hash_secret[3], read64(p + 40) ^ lane2);
+                p += 48;
+                left -= 48;
+            } while (left > 48);
+            seed ^= lane1 ^ lane2;
+        }
+
+        while (left > 16) {
+            seed = hash_mix(read64(p) ^ hash_secret[1], read64(p + 8) ^ seed);
+            p += 16;
+            left -= 16;
+        }
+
+        a = read64(p + left - 16);
+        b = read64(p + left - 8);
+    }
+
+    a ^= hash_secret[1];
+    b ^= seed;
+    hash_multiply(&a, &b);
+    return hash_mix(a ^ hash_secret[0] ^ length, b ^ hash_secret[1]);
+}
+
+int token_cache_open(Token_cache *cache, const char *dir, size_t limit) {
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) return -1;
+
+    struct stat st;
+    if (stat(dir, &st) < 0) return -1;
+    if (!S_ISDIR(st.st_mode)) {
+        errno = ENOTDIR;
+        return -1;
+    }
+
+    cache->dir = strdup(dir);
+    if (!cache->dir) return -1;
+
+    cache->limit = limit;
+
+    // the umask can only be read by setting it, done once here before any
+    // worker stores entries
+    mode_t mask = umask(0);
+    umask(mask);
+    cache->mode = 0666 & ~mask;
+    return 0;
+}
+
+static void entry_path(Token_cache *cache, uint64_t hash, char *path, size_t size) {
+    snprintf(path, size, "%s/%016llx.tok", cache->dir, (unsigned long long)hash);
+}
+
+// returns 1 and maps the entry when source was cached, 0 otherwise. on a
+// miss the entry still carries the hash for token_cache_store
+int token_cache_lookup(Token_cache *cache, const char *source, size_t length, Token_cache_entry *entry) {
+    entry->hash = token_cache_hash(source, length, TOKEN_CACHE_SEED);
+    entry->file.data = NULL;
+
+    char path[PATH_MAX];
+    entry_path(cache, entry->hash, path, sizeof path);
+
+    // a missing, truncated, corrupt or foreign entry is just a miss,
+    // token_file_open checks every record against the string table
+    if (token_file_open(path, &entry->file) < 0) return 0;
+
+    if (entry->file.header->strings_size != length ||
+        memcmp(entry->file.strings, source, length) != 0) {
+        token_cache_release(entry);
+        return 0;
+    }
+
+    // the mtime is the recency token_cache_trim evicts by
+    utimensat(AT_FDCWD, path, NULL, 0);
+    return 1;
+}
+
+// the entry is written under a temporary name and renamed into place, so
+// concurrent runs never see half an entry
+int token_cache_store(Token_cache *cache, Token_cache_entry *entry, Lexer *lexer) {
+    char temp[PATH_MAX];
+    snprintf(temp, sizeof temp, "%s/.tmp-XXXXXX", cache->dir);
+
+    int fd = mkstemp(temp);
+    if (fd < 0) return -1;
+
+    // mkstemp makes the file private to its owner and rename keeps that,
+    // an entry is readable by everyone who shares the cache directory
+    if (fchmod(fd, cache->mode) < 0) {
+        int saved = errno;
+        close(fd);
+        unlink(temp);
+        errno = saved;
+        return -1;
+    }
+
+    char path[PATH_MAX];
+    entry_path(cache, entry->hash, path, sizeof path);
+
+    int result = token_file_write(fd, lexer);
+    if (close(fd) < 0) result = -1;
+    if (result == 0 && rename(temp, path) < 0) result = -1;
+
+    if (result < 0) {
+        int saved = errno;
+        unlink(temp);
+        errno = saved;
+        return -1;
+    }
+
+    return 0;
+}
+
+void token_cache_release(Token_cache_entry *entry) {
+    if (entry->file.data) {
+        token_file_close(&entry->file);
+    }
+}
+
+typedef struct {
+    char *name;
+    size_t size;
+    struct timespec mtime;
+} Cache_file;
+
+static int compare_mtime(const void *a, const void *b) {
+    const struct timespec *ta = &((const Cache_file *)a)->mtime;
+    const struct timespec *tb = &((const Cache_file *)b)->mtime;
+    if (ta->tv_sec != tb->tv_sec) return (ta->tv_sec > tb->tv_sec) - (ta->tv_sec < tb->tv_sec);
+    return (ta->tv_nsec > tb->tv_nsec) - (ta->tv_nsec < tb->tv_nsec);
+}
+
+// deletes the least recently used entries until the rest fit in the
+// limit. meant to run once at the end of a run, it reads the whole dir
+int token_cache_trim(Token_cache *cache) {
+    DIR *dir = opendir(cache->dir);
+    if (!dir) return -1;
+
+    Cache_file *files = NULL;
+    size_t count = 0, capacity = 0;
+    size_t total = 0;
+    time_t now = time(NULL);
+
+    struct dirent *dirent;
+    while ((dirent = readdir(dir)) != NULL) {
+        const char *name = dirent->d_name;
+
+        struct stat st;
+        if (fstatat(dirfd(dir), name, &st, 0) < 0 || !S_ISREG(st.st_mode)) continue;
+
+        if (strncmp(name, ".tmp-", 5) == 0) {
+            if (now - st.st_mtime > TOKEN_CACHE_STALE_SECONDS) {
+                unlinkat(dirfd(dir), name, 0);
+            }
+            continue;
+        }
+
+        size_t name_len = strlen(name);
+        if (name_len < 4 || strcmp(name + name_len - 4, ".tok") != 0) continue;
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            Cache_file *grown = realloc(files, sizeof(Cache_file) * capacity);
+            if (!grown) break;
+            files = grown;
+        }
+
+        files[count].name = strdup(name);
+        if (!files[count].name) break;
+        files[count].size = st.st_size;
+        files[count].mtime = st.st_mtim;
+        total += st.st_size;
+        count++;
+    }
+
+    if (total > cache->limit) {
+        qsort(files, count, sizeof(Cache_file), compare_mtime);
+
+        for (size_t i = 0; i < count && total > cache->limit; i++) {
+            if (unlinkat(dirfd(dir), files[i].name, 0) == 0) {
+                total -= files[i].size;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        free(files[i].name);
+    }
+    free(files);
+    closedir(dir);
+
+    return 0;
+}
+
+void token_cache_close(Token_cache *cache) {
+    free(cache->dir);
+    cache->dir = NULL;
+}
@@ -0,0 +1,195 @@
+#include "token_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static uint64_t align8(uint64_t size) { return (size + 7) & ~(uint64_t)7; }
+
+// writev may stop early on pipes and sockets, keep going from where it did
+static int write_vector(int fd, struct iovec *vector, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, vector, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        while (count > 0 && (size_t)n >= vector->iov_len) {
+            n -= vector->iov_len;
+            vector++;
+            count--;
+        }
+        if (count > 0) {
+            vector->iov_base = (char *)vector->iov_base + n;
+            vector->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+// the lexer must hold the whole source (lexer_set_source), its tokens are
+// turned into records and everything goes out in one writev
+int token_file_write(int fd, Lexer *lexer) {
+    Token_buffer *tokens = &lexer->tokens;
+
+    Token_file_header header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, TOKEN_FILE_MAGIC, sizeof TOKEN_FILE_MAGIC);
+    header.version = TOKEN_FILE_VERSION;
+    header.byte_order = TOKEN_FILE_BYTE_ORDER;
+    header.header_size = sizeof(Token_file_header);
+    header.record_size = sizeof(Token_record);
+    header.token_count = tokens->count;
+    header.strings_offset = sizeof(Token_file_header);
+    header.strings_size = lexer->length;
+    header.records_offset = align8(header.strings_offset + header.strings_size);
+
+    Token_record *records = malloc(sizeof(Token_record) * (tokens->count ? tokens->count : 1));
+    if (!records) return -1;
+
+    for (size_t i = 0; i < tokens->count; i++) {
+        records[i] = (Token_record){
+            .offset = tokens->offsets[i],
+            .length = tokens->lengths[i],
+            .type = tokens->types[i],
+        };
+    }
+
+    static const char padding[8];
+    struct iovec vector[] = {
+        { &header, sizeof header },
+        { (void *)lexer->source, lexer->length },
+        { (void *)padding, header.records_offset - header.strings_offset - header.strings_size },
+        { records, sizeof(Token_record) * tokens->count },
+    };
+
+    int result = write_vector(fd, vector, sizeof vector / sizeof vector[0]);
+
+    int saved = errno;
+    free(records);
+    errno = saved;
+    return result;
+}
+
+// checks the header, the section bounds and every record of a dump
+// already in memory, the file then points into data. the dump is
+// untrusted input, a record must name a known type and a span inside the
+// string table. returns -1 with errno EINVAL if it is not a well formed
+// token file of this version and byte order
+int token_file_map(const void *data, size_t size, Token_file *file) {
+    const Token_file_header *header = data;
+
+    if (size < sizeof(Token_file_header) ||
+        memcmp(header->magic, TOKEN_FILE_MAGIC, sizeof TOKEN_FILE_MAGIC) != 0 ||
+        header->version != TOKEN_FILE_VERSION ||
+        header->byte_order != TOKEN_FILE_BYTE_ORDER ||
+        header->header_size != sizeof(Token_file_header) ||
+        header->record_size != sizeof(Token_record) ||
+        header->strings_offset > size ||
+        header->strings_size > size - header->strings_offset ||
+        header->records_offset % 8 != 0 ||
+        header->records_offset > size ||
+        header->token_count > (size - header->records_offset) / sizeof(Token_record)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const Token_record *records = (const Token_record *)((const char *)data + header->records_offset);
+    for (size_t i = 0; i < header->token_count; i++) {
+        const Token_record *record = &records[i];
+        if (record->type > TOKEN_EOF || (uint64_t)record->offset + record->length > header->strings_size) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    file->header = header;
+    file->strings = (const char *)data + header->strings_offset;
+    file->records = records;
+    file->count = header->token_count;
+    file->data = NULL;
+    file->size = size;
+    return 0;
+}
+
+// copies the records into the lexer's token buffer as if the lexer had
+// scanned the string table itself. the lexer source is left alone, it
+// must hold the same text, token_file_map has checked that every record
+// lies inside it. on failure the lexer is unchanged
+int token_file_load(const Token_file *file, Lexer *lexer) {
+    Token_buffer *tokens = &lexer->tokens;
+
+    if (file->header->strings_size > lexer->length) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (token_buffer_reserve(tokens, file->count) < 0) return -1;
+
+    for (size_t i = 0; i < file->count; i++) {
+        const Token_record *record = &file->records[i];
+        tokens->types[i] = record->type;
+        tokens->offsets[i] = record->offset;
+        tokens->lengths[i] = record->length;
+        tokens->payloads[i] = 0;
+        tokens->values[i] = 0;
+    }
+
+    tokens->count = file->count;
+    lexer_intern_tokens(lexer, 0, tokens->count);
+    lexer_decode_numbers(lexer, 0, tokens->count);
+    lexer->position = lexer->length;
+    return 0;
+}
+
+int token_file_open(const char *path, Token_file *file) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    if (st.st_size < (off_t)sizeof(Token_file_header)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int saved = errno;
+    close(fd);
+    if (data == MAP_FAILED) {
+        errno = saved;
+        return -1;
+    }
+
+    if (token_file_map(data, st.st_size, file) < 0) {
+        munmap(data, st.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    file->data = data;
+    return 0;
+}
+
+// only unmaps what token_file_open mapped
+void token_file_close(Token_file *file) {
+    if (file->data) {
+        munmap(file->data, file->size);
+    }
+
+    file->data = NULL;
+    file->header = NULL;
+    file->records = NULL;
+    file->count = 0;
+}
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "incremental.h"
+
+// every incremental edit has to leave the tokens and diagnostics a full
+// re-lex of the new text gives, and report the tokens it replaced
+// correctly. the edits are random and small, over alphabets that keep
+// opening and closing comments, strings and numbers
+
+static int failures = 0;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static const char *alphabets[] = {
+    "ab_ \n;{}()=+0x9.1\"'Ff",
+    "a ..\n.<>=-&|+#/*",
+    "a /*\n*/ b;",
+};
+
+static unsigned seed = 1;
+
+static size_t next(size_t below) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % below;
+}
+
+static int same_token(const Token_buffer *a, size_t i, const Token_buffer *b, size_t j, long shift) {
+    if (a->types[i] != b->types[j]) return 0;
+    if (a->lengths[i] != b->lengths[j]) return 0;
+    if ((long)a->offsets[i] + shift != (long)b->offsets[j]) return 0;
+    // identifiers are interned, their ids depend on the table
+    if (a->types[i] != TOKEN_NUMBER_LITERAL) return 1;
+    return a->values[i] == b->values[j] && a->payloads[i] == b->payloads[j];
+}
+
+// inc against a full re-lex of its text
+static int matches_full(Incremental_lexer *inc) {
+    Lexer full;
+    lexer_initialize(&full);
+    lexer_set_source(&full, inc->text, inc->length);
+    lexer_scan_all(&full);
+    lexer_locate_diagnostics(&full);
+
+    Token_buffer *a = &inc->lexer.tokens, *b = &full.tokens;
+    int same = a->count == b->count;
+    for (size_t i = 0; same && i < a->count; i++) same = same_token(a, i, b, i, 0);
+
+    Diagnostic_list *x = &inc->lexer.diagnostics, *y = &full.diagnostics;
+    same = same && x->count == y->count;
+    for (size_t i = 0; same && i < x->count; i++) {
+        same = x->items[i].offset == y->items[i].offset && x->items[i].code == y->items[i].code &&
+               x->items[i].line == y->items[i].line && x->items[i].col == y->items[i].col &&
+               strcmp(x->items[i].message, y->items[i].message) == 0;
+    }
+
+    lexer_cleanup(&full);
+    return same;
+}
+
+// tokens outside the reported window are the old ones, moved by the edit
+static int window_holds(const Token_buffer *old, const Token_buffer *now, const Token_edit *changed,
+                        long shift) {
+    if (changed->first + changed->removed > old->count) return 0;
+    if (old->count - changed->removed + changed->inserted != now->count) return 0;
+
+    for (size_t i = 0; i < changed->first; i++) {
+        if (!same_token(old, i, now, i, 0)) return 0;
+    }
+
+    size_t after = old->count - changed->first - changed->removed;
+    for (size_t i = 0; i < after; i++) {
+        size_t from = changed->first + changed->removed + i;
+        size_t to = changed->first + changed->inserted + i;
+        if (!same_token(old, from, now, to, shift)) return 0;
+    }
+
+    return 1;
+}
+
+static void copy_tokens(Token_buffer *copy, const Token_buffer *tokens) {
+    CHECK(token_buffer_reserve(copy, tokens->count) == 0);
+    copy->count = tokens->count;
+    if (tokens->count == 0) return;
+
+    memcpy(copy->types, tokens->types, tokens->count * sizeof(uint8_t));
+    memcpy(copy->offsets, tokens->offsets, tokens->count * sizeof(uint32_t));
+    memcpy(copy->lengths, tokens->lengths, tokens->count * sizeof(uint32_t));
+    memcpy(copy->payloads, tokens->payloads, tokens->count * sizeof(uint32_t));
+    memcpy(copy->values, tokens->values, tokens->count * sizeof(uint64_t));
+}
+
+static void test_random_edits(const char *alphabet, int edits) {
+    size_t size = strlen(alphabet);
+    char text[600];
+    for (size_t i = 0; i < sizeof text; i++) text[i] = alphabet[next(size)];
+
+    Incremental_lexer inc;
+    CHECK(incremental_initialize(&inc, text, sizeof text) == 0);
+    CHECK(matches_full(&inc));
+
+    Token_buffer old;
+    token_buffer_initialize(&old);
+
+    for (int e = 0; e < edits; e++) {
+        size_t offset = next(inc.length + 1);
+        size_t removed = next(4);
+        if (removed > inc.length - offset) removed = inc.length - offset;
+
+        char inserted[4];
+        size_t inserted_length = next(4);
+        for (size_t i = 0; i < inserted_length; i++) inserted[i] = alphabet[next(size)];
+        if (inc.length > 2000) inserted_length = 0;
+
+        copy_tokens(&old, &inc.lexer.tokens);
+
+        Token_edit changed;
+        CHECK(incremental_edit(&inc, offset, removed, inserted, inserted_length, &changed) == 0);
+
+        int same = matches_full(&inc);
+        CHECK(same);
+        CHECK(window_holds(&old, &inc.lexer.tokens, &changed, (long)inserted_length - (long)removed));
+        if (!same) {
+            fprintf(stderr, "  edit %d of \"%s\": %zu at %zu\n", e, alphabet, removed, offset);
+            break;
+        }
+    }
+
+    token_buffer_free(&old);
+    incremental_cleanup(&inc);
+}
+
+// an edit that empties the text and one that fills it again
+static void test_empty(void) {
+    const char *text = "int x = 1; /* c */";
+    Incremental_lexer inc;
+    CHECK(incremental_initialize(&inc, text, strlen(text)) == 0);
+
+    Token_edit changed;
+    CHECK(incremental_edit(&inc, 0, inc.length, NULL, 0, &changed) == 0);
+    CHECK(inc.length == 0);
+    CHECK(matches_full(&inc));
+
+    CHECK(incremental_edit(&inc, 0, 0, text, strlen(text), &changed) == 0);
+    CHECK(matches_full(&inc));
+
+    incremental_cleanup(&inc);
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof alphabets / sizeof alphabets[0]; i++) {
+        test_random_edits(alphabets[i], 3000);
+    }
+    test_empty();
+
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("incremental: ok\n");
+    return 0;
+}
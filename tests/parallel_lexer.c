@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "lexer.h"
+#include "parallel_lexer.h"
+
+// lexer_scan_parallel has to give exactly what lexer_scan_all gives. the
+// chunks are made tiny so block comments, strings and bad literals
+// keep landing across chunk boundaries
+
+static int failures = 0;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static const char *pieces[] = {
+    "int x = 42;\n",
+    "/* a block comment\n   over two lines with \"quotes\" and // slashes */\n",
+    "/**/",
+    "char *s = \"a string // not a comment /* nor this */\";\n",
+    "// a line comment with /* an opener\n",
+    "c = 'q';\n",
+    "f(1.5f, 0x1F, 0b101, 017);\n",
+    "a->b <<= c >> 2 && d != e;\n",
+    "\"unterminated\n",
+    "bad = 0x1G + 09 + 12abc;\n",
+    "\n\n",
+    "    \t",
+    "identifier_with_a_longer_name",
+    "#include <stdio.h>\n",
+};
+
+// a deterministic mix of the pieces, NUL terminated
+static char *make_source(unsigned seed, size_t count, size_t *length) {
+    size_t capacity = 1;
+    for (size_t i = 0; i < sizeof pieces / sizeof pieces[0]; i++) capacity += strlen(pieces[i]) * count;
+
+    char *source = malloc(capacity);
+    if (!source) return NULL;
+
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        const char *piece = pieces[(seed >> 16) % (sizeof pieces / sizeof pieces[0])];
+        size_t size = strlen(piece);
+        memcpy(source + used, piece, size);
+        used += size;
+    }
+
+    source[used] = '\0';
+    *length = used;
+    return source;
+}
+
+static void compare(Lexer *serial, Lexer *parallel) {
+    Token_buffer *a = &serial->tokens, *b = &parallel->tokens;
+    CHECK(a->count == b->count);
+
+    int same = a->count == b->count;
+    for (size_t i = 0; same && i < a->count; i++) {
+        same = a->types[i] == b->types[i] && a->offsets[i] == b->offsets[i] &&
+               a->lengths[i] == b->lengths[i] && a->payloads[i] == b->payloads[i] &&
+               a->values[i] == b->values[i];
+    }
+    CHECK(same);
+
+    Diagnostic_list *x = &serial->diagnostics, *y = &parallel->diagnostics;
+    CHECK(x->count == y->count);
+
+    same = x->count == y->count;
+    for (size_t i = 0; same && i < x->count; i++) {
+        same = x->items[i].offset == y->items[i].offset && x->items[i].code == y->items[i].code &&
+               x->items[i].line == y->items[i].line && x->items[i].col == y->items[i].col &&
+               strcmp(x->items[i].message, y->items[i].message) == 0;
+    }
+    CHECK(same);
+}
+
+static void test_matches_serial(Thread_pool *pool, const char *source, size_t length, size_t min_chunk) {
+    Lexer serial, parallel;
+    lexer_initialize(&serial);
+    lexer_initialize(&parallel);
+
+    lexer_set_source(&serial, source, length);
+    lexer_scan_all(&serial);
+    lexer_locate_diagnostics(&serial);
+
+    lexer_set_source(&parallel, source, length);
+    CHECK(lexer_scan_parallel(&parallel, pool, min_chunk) == serial.tokens.count);
+
+    compare(&serial, &parallel);
+
+    lexer_cleanup(&serial);
+    lexer_cleanup(&parallel);
+}
+
+// a comment that is still open at the end spans every chunk after its
+// start, the chunks past it have nothing left to re-lex
+static void test_unterminated_comment(Thread_pool *pool) {
+    size_t length;
+    char *body = make_source(7, 200, &length);
+    if (!body) return;
+
+    const char *line = "no closing star slash on this line\n";
+    size_t lines = 200, size = strlen(line);
+    char *source = malloc(length + 8 + lines * size);
+    if (!source) return;
+
+    size_t used = length;
+    memcpy(source, body, length);
+    memcpy(source + used, "/* open\n", 8);
+    used += 8;
+    for (size_t i = 0; i < lines; i++, used += size) memcpy(source + used, line, size);
+
+    size_t chunks[] = { 16, 64, 257 };
+    for (size_t i = 0; i < sizeof chunks / sizeof chunks[0]; i++) {
+        test_matches_serial(pool, source, used, chunks[i]);
+    }
+
+    free(source);
+    free(body);
+}
+
+int main(void) {
+    for (int workers = 1; workers <= 4; workers++) {
+        Thread_pool pool;
+        if (thread_pool_initialize(&pool, workers) < 0) {
+            perror("thread_pool_initialize");
+            return 1;
+        }
+
+        for (unsigned seed = 1; seed <= 8; seed++) {
+            size_t length;
+            char *source = make_source(seed, 400, &length);
+            CHECK(source != NULL);
+            if (!source) continue;
+
+            size_t chunks[] = { 16, 64, 257, 4096, length };
+            for (size_t i = 0; i < sizeof chunks / sizeof chunks[0]; i++) {
+                test_matches_serial(&pool, source, length, chunks[i]);
+            }
+            free(source);
+        }
+
+        test_unterminated_comment(&pool);
+        test_matches_serial(&pool, "", 0, 16);
+
+        thread_pool_destroy(&pool);
+    }
+
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("parallel_lexer: ok\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "lexer.h"
+#include "printer.h"
+
+// printer output checks, the printer collects into its buffer (out is
+// NULL) and the text is compared there
+
+static int failures = 0;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+// the formatted tokens of source, NUL terminated in the printer buffer
+static const char *print_source(Printer *printer, Lexer *lexer, const char *source, Print_format format) {
+    lexer_initialize(lexer);
+    lexer_set_source(lexer, source, strlen(source));
+    lexer_scan_all(lexer);
+
+    printer_initialize(printer, NULL, format, 0);
+    printer_tokens(printer, lexer);
+    printer_end(printer);
+
+    char *end = printer->buffer + printer->used;
+    *end = '\0';
+    return printer->buffer;
+}
+
+static int contains(const char *text, const char *part) { return strstr(text, part) != NULL; }
+
+// UTF-8 goes through unchanged, it is not escaped byte by byte
+static void test_jsonl_utf8(void) {
+    Printer printer;
+    Lexer lexer;
+    const char *out = print_source(&printer, &lexer, "s = \"caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80\";\n",
+                                   PRINT_JSONL);
+
+    CHECK(contains(out, "\"text\":\"caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80\""));
+    CHECK(!contains(out, "\\u00c3"));
+
+    printer_free(&printer);
+    lexer_cleanup(&lexer);
+}
+
+// stray bytes, a truncated sequence, an overlong form and a surrogate
+// each become U+FFFD, control characters and DEL are escaped
+static void test_jsonl_invalid_bytes(void) {
+    const char *sources[] = { "\xff", "\xc3", "\xc0\xaf", "\xed\xa0\x80" };
+
+    for (size_t i = 0; i < sizeof sources / sizeof sources[0]; i++) {
+        Printer printer;
+        Lexer lexer;
+        const char *out = print_source(&printer, &lexer, sources[i], PRINT_JSONL);
+
+        CHECK(contains(out, "\"text\":\"\\ufffd"));
+        for (const char *p = out; *p; p++) {
+            CHECK((unsigned char)*p < 0x80);
+        }
+
+        printer_free(&printer);
+        lexer_cleanup(&lexer);
+    }
+
+    Printer printer;
+    Lexer lexer;
+    const char *out = print_source(&printer, &lexer, "\"a\tb\x7f\"", PRINT_JSONL);
+    CHECK(contains(out, "a\\u0009b\\u007f"));
+
+    printer_free(&printer);
+    lexer_cleanup(&lexer);
+}
+
+int main(void) {
+    test_jsonl_utf8();
+    test_jsonl_invalid_bytes();
+
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("printer: ok\n");
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "incremental.h"
+#include "token_buffer.h"
+
+// token_buffer_splice checks, built with the sanitizers by make test so a
+// copy from a column that was never allocated fails the run
+
+static int failures = 0;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+// a re-lex that found no tokens has a source with no arrays at all
+static void test_splice_empty_source(void) {
+    Token_buffer buffer, empty;
+    token_buffer_initialize(&buffer);
+    token_buffer_initialize(&empty);
+
+    for (uint32_t i = 0; i < 4; i++) {
+        token_buffer_push(&buffer, 1, i * 2, 1);
+    }
+
+    CHECK(token_buffer_splice(&buffer, 1, 2, &empty) == 0);
+    CHECK(buffer.count == 2);
+    CHECK(buffer.offsets[0] == 0 && buffer.offsets[1] == 6);
+
+    // removing the last rows leaves no tail to move
+    CHECK(token_buffer_splice(&buffer, 1, 1, &empty) == 0);
+    CHECK(buffer.count == 1 && buffer.offsets[0] == 0);
+
+    token_buffer_free(&buffer);
+}
+
+static void test_splice_into_empty(void) {
+    Token_buffer buffer, empty;
+    token_buffer_initialize(&buffer);
+    token_buffer_initialize(&empty);
+
+    CHECK(token_buffer_splice(&buffer, 0, 0, &empty) == 0);
+    CHECK(buffer.count == 0);
+
+    token_buffer_free(&buffer);
+}
+
+// deleting a leading token re-lexes a span with nothing in it, the rows
+// after it are kept and shifted
+static void test_edit_relexes_nothing(void) {
+    const char *text = "a b c";
+    Incremental_lexer inc;
+    CHECK(incremental_initialize(&inc, text, strlen(text)) == 0);
+    CHECK(inc.lexer.tokens.count == 3);
+
+    Token_edit changed;
+    CHECK(incremental_edit(&inc, 0, 2, NULL, 0, &changed) == 0);
+    CHECK(changed.first == 0 && changed.removed == 1 && changed.inserted == 0);
+    CHECK(inc.lexer.tokens.count == 2);
+    CHECK(inc.lexer.tokens.offsets[0] == 0 && inc.lexer.tokens.offsets[1] == 2);
+
+    incremental_cleanup(&inc);
+}
+
+int main(void) {
+    test_splice_empty_source();
+    test_splice_into_empty();
+    test_edit_relexes_nothing();
+
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("token_buffer: ok\n");
+    return 0;
+}
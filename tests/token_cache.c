@@ -0,0 +1,170 @@
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lexer.h"
+#include "token_cache.h"
+
+// the on disk token cache: a stored entry is found again, and an entry
+// that was damaged or belongs to other text is a miss, never a hit
+
+static int failures = 0;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static const char *source = "int f(int x) {\n"
+                            "    return x * 0x10 + 1.5; /* done */\n"
+                            "}\n";
+
+// the path of the one entry in dir, 0 if there is none
+static int entry_file(const char *dir, char *path, size_t size) {
+    DIR *d = opendir(dir);
+    if (!d) return 0;
+
+    int found = 0;
+    struct dirent *item;
+    while ((item = readdir(d))) {
+        size_t length = strlen(item->d_name);
+        if (length > 4 && strcmp(item->d_name + length - 4, ".tok") == 0) {
+            snprintf(path, size, "%s/%s", dir, item->d_name);
+            found = 1;
+        }
+    }
+
+    closedir(d);
+    return found;
+}
+
+static int lookup(Token_cache *cache, const char *text, Token_cache_entry *entry) {
+    return token_cache_lookup(cache, text, strlen(text), entry);
+}
+
+static void store(Token_cache *cache, const char *text) {
+    Lexer lexer;
+    lexer_initialize(&lexer);
+    lexer_set_source(&lexer, text, strlen(text));
+    lexer_scan_all(&lexer);
+
+    Token_cache_entry entry;
+    CHECK(!lookup(cache, text, &entry));
+    CHECK(token_cache_store(cache, &entry, &lexer) == 0);
+
+    lexer_cleanup(&lexer);
+}
+
+static void test_store_then_hit(Token_cache *cache, const char *dir) {
+    store(cache, source);
+
+    Lexer lexer;
+    lexer_initialize(&lexer);
+    lexer_set_source(&lexer, source, strlen(source));
+    size_t count = lexer_scan_all(&lexer);
+
+    Token_cache_entry entry;
+    CHECK(lookup(cache, source, &entry));
+    CHECK(entry.file.count == count);
+    token_cache_release(&entry);
+
+    // other text is not served by the entry
+    CHECK(!lookup(cache, "int g;", &entry));
+    token_cache_release(&entry);
+
+    // readable by everyone who shares the directory, as far as the umask allows
+    char path[PATH_MAX];
+    struct stat st;
+    CHECK(entry_file(dir, path, sizeof path));
+    CHECK(stat(path, &st) == 0 && (st.st_mode & 0777) == 0644);
+
+    lexer_cleanup(&lexer);
+}
+
+// damage the stored entry with change, the next lookup has to miss and a
+// store has to bring the entry back
+static void test_damaged(Token_cache *cache, const char *dir, void (*change)(const char *path)) {
+    char path[PATH_MAX];
+    CHECK(entry_file(dir, path, sizeof path));
+    change(path);
+
+    Token_cache_entry entry;
+    CHECK(!lookup(cache, source, &entry));
+    token_cache_release(&entry);
+
+    store(cache, source);
+    CHECK(lookup(cache, source, &entry));
+    token_cache_release(&entry);
+}
+
+static void truncate_entry(const char *path) { CHECK(truncate(path, 100) == 0); }
+
+// the last record points past the string table
+static void corrupt_record(const char *path) {
+    FILE *file = fopen(path, "r+b");
+    CHECK(file != NULL);
+    if (!file) return;
+
+    Token_file_header header;
+    CHECK(fread(&header, sizeof header, 1, file) == 1);
+
+    Token_record record;
+    long at = header.records_offset + (header.token_count - 1) * sizeof(Token_record);
+    CHECK(fseek(file, at, SEEK_SET) == 0 && fread(&record, sizeof record, 1, file) == 1);
+    record.offset = 0x7fffff00;
+    CHECK(fseek(file, at, SEEK_SET) == 0 && fwrite(&record, sizeof record, 1, file) == 1);
+
+    fclose(file);
+}
+
+// an entry of some other build
+static void foreign_version(const char *path) {
+    FILE *file = fopen(path, "r+b");
+    CHECK(file != NULL);
+    if (!file) return;
+
+    Token_file_header header;
+    CHECK(fread(&header, sizeof header, 1, file) == 1);
+    header.version++;
+    CHECK(fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof header, 1, file) == 1);
+
+    fclose(file);
+}
+
+int main(void) {
+    umask(022);
+
+    char dir[] = "/tmp/token-cache-test-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    Token_cache cache;
+    CHECK(token_cache_open(&cache, dir, TOKEN_CACHE_DEFAULT_LIMIT) == 0);
+
+    test_store_then_hit(&cache, dir);
+    test_damaged(&cache, dir, truncate_entry);
+    test_damaged(&cache, dir, corrupt_record);
+    test_damaged(&cache, dir, foreign_version);
+
+    token_cache_close(&cache);
+
+    char path[PATH_MAX];
+    while (entry_file(dir, path, sizeof path)) unlink(path);
+    rmdir(dir);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("token_cache: ok\n");
+    return 0;
+}
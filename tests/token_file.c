@@ -0,0 +1,217 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lexer.h"
+#include "token_file.h"
+
+// binary token dumps: what token_file_write puts out token_file_map and
+// token_file_load read back, and a damaged dump is rejected, never read
+// past its end
+
+static int failures = 0;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static const char *source = "int main(void) {\n"
+                            "    /* block */ char *s = \"text\";\n"
+                            "    return 0x1f + 2.5f + x; // line\n"
+                            "}\n";
+
+// the dump of lexer in memory, read back from a temporary file
+static char *dump(Lexer *lexer, size_t *size) {
+    FILE *file = tmpfile();
+    if (!file) return NULL;
+
+    char *data = NULL;
+    if (token_file_write(fileno(file), lexer) == 0) {
+        long end = lseek(fileno(file), 0, SEEK_END);
+        data = malloc(end);
+        if (data && pread(fileno(file), data, end, 0) == end) {
+            *size = end;
+        }
+        else {
+            free(data);
+            data = NULL;
+        }
+    }
+
+    fclose(file);
+    return data;
+}
+
+static Token_record *records_of(char *data) {
+    const Token_file_header *header = (const Token_file_header *)data;
+    return (Token_record *)(data + header->records_offset);
+}
+
+static void test_round_trip(Lexer *lexer) {
+    size_t size;
+    char *data = dump(lexer, &size);
+    CHECK(data != NULL);
+    if (!data) return;
+
+    Token_file file;
+    CHECK(token_file_map(data, size, &file) == 0);
+    CHECK(file.count == lexer->tokens.count);
+    CHECK(file.header->strings_size == strlen(source));
+    CHECK(memcmp(file.strings, source, strlen(source)) == 0);
+
+    for (size_t i = 0; i < file.count && i < lexer->tokens.count; i++) {
+        CHECK(file.records[i].type == lexer->tokens.types[i]);
+        CHECK(file.records[i].offset == lexer->tokens.offsets[i]);
+        CHECK(file.records[i].length == lexer->tokens.lengths[i]);
+    }
+
+    // loaded tokens get back what the lexer derives from the text
+    Lexer loaded;
+    lexer_initialize(&loaded);
+    lexer_set_source(&loaded, source, strlen(source));
+    CHECK(token_file_load(&file, &loaded) == 0);
+    CHECK(loaded.tokens.count == lexer->tokens.count);
+    for (size_t i = 0; i < loaded.tokens.count && i < lexer->tokens.count; i++) {
+        CHECK(loaded.tokens.types[i] == lexer->tokens.types[i]);
+        CHECK(loaded.tokens.offsets[i] == lexer->tokens.offsets[i]);
+        CHECK(loaded.tokens.lengths[i] == lexer->tokens.lengths[i]);
+        CHECK(loaded.tokens.payloads[i] == lexer->tokens.payloads[i]);
+        CHECK(loaded.tokens.values[i] == lexer->tokens.values[i]);
+    }
+
+    lexer_cleanup(&loaded);
+    free(data);
+}
+
+static void test_open(Lexer *lexer) {
+    char path[] = "/tmp/token-file-test-XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+
+    CHECK(token_file_write(fd, lexer) == 0);
+    close(fd);
+
+    Token_file file;
+    CHECK(token_file_open(path, &file) == 0);
+    CHECK(file.count == lexer->tokens.count);
+    token_file_close(&file);
+
+    // too short to even hold a header
+    CHECK(truncate(path, sizeof(Token_file_header) - 1) == 0);
+    errno = 0;
+    CHECK(token_file_open(path, &file) < 0 && errno == EINVAL);
+
+    unlink(path);
+}
+
+// every cut of the dump short of its full size drops part of the records
+static void test_truncated(Lexer *lexer) {
+    size_t size;
+    char *data = dump(lexer, &size);
+    CHECK(data != NULL);
+    if (!data) return;
+
+    Token_file file;
+    for (size_t cut = 0; cut < size; cut++) {
+        errno = 0;
+        CHECK(token_file_map(data, cut, &file) < 0 && errno == EINVAL);
+    }
+
+    free(data);
+}
+
+// a record is rejected when its span leaves the string table or its type
+// is not a TokenType
+static void test_bad_records(Lexer *lexer) {
+    size_t size;
+    char *data = dump(lexer, &size);
+    CHECK(data != NULL);
+    if (!data) return;
+
+    Token_record *records = records_of(data);
+    uint32_t strings_size = strlen(source);
+    Token_file file;
+
+    Token_record saved = records[3];
+    records[3].offset = 0x7fffff00;
+    CHECK(token_file_map(data, size, &file) < 0 && errno == EINVAL);
+    records[3] = saved;
+
+    records[3].offset = strings_size - 1;
+    records[3].length = 2;
+    CHECK(token_file_map(data, size, &file) < 0 && errno == EINVAL);
+    records[3] = saved;
+
+    // offset and length each fit, their sum wraps a 32 bit add
+    records[3].offset = strings_size;
+    records[3].length = UINT32_MAX;
+    CHECK(token_file_map(data, size, &file) < 0 && errno == EINVAL);
+    records[3] = saved;
+
+    records[3].type = TOKEN_EOF + 1;
+    CHECK(token_file_map(data, size, &file) < 0 && errno == EINVAL);
+    records[3] = saved;
+
+    // a record that ends exactly at the end of the string table is fine
+    records[3].offset = strings_size - 1;
+    records[3].length = 1;
+    CHECK(token_file_map(data, size, &file) == 0);
+    records[3] = saved;
+
+    free(data);
+}
+
+static void test_bad_header(Lexer *lexer) {
+    size_t size;
+    char *data = dump(lexer, &size);
+    CHECK(data != NULL);
+    if (!data) return;
+
+    Token_file_header *header = (Token_file_header *)data;
+    Token_file file;
+
+    header->version = TOKEN_FILE_VERSION + 1;
+    CHECK(token_file_map(data, size, &file) < 0 && errno == EINVAL);
+    header->version = TOKEN_FILE_VERSION;
+
+    header->magic[0] = 'X';
+    CHECK(token_file_map(data, size, &file) < 0 && errno == EINVAL);
+    header->magic[0] = TOKEN_FILE_MAGIC[0];
+
+    header->token_count++;
+    CHECK(token_file_map(data, size, &file) < 0 && errno == EINVAL);
+    header->token_count--;
+
+    header->strings_size = size;
+    CHECK(token_file_map(data, size, &file) < 0 && errno == EINVAL);
+
+    free(data);
+}
+
+int main(void) {
+    Lexer lexer;
+    lexer_initialize(&lexer);
+    lexer_set_source(&lexer, source, strlen(source));
+    lexer_scan_all(&lexer);
+
+    test_round_trip(&lexer);
+    test_open(&lexer);
+    test_truncated(&lexer);
+    test_bad_records(&lexer);
+    test_bad_header(&lexer);
+
+    lexer_cleanup(&lexer);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("token_file: ok\n");
+    return 0;
+}